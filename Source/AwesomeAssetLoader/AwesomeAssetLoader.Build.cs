@@ -26,6 +26,7 @@ public class AwesomeAssetLoader : ModuleRules
 			new string[]
 			{
 				"Core",
+				"DeveloperSettings",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -38,7 +39,8 @@ public class AwesomeAssetLoader : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore",
-				"GameplayTags"
+				"GameplayTags",
+				"AssetRegistry"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
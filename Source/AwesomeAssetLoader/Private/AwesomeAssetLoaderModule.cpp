@@ -1,18 +1,32 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "..\Public\AwesomeAssetLoaderModule.h"
+#include "ItemLibraryArchive.h"
+#if WITH_EDITOR
+#include "UObject/ICookInfo.h"
+#endif
 
 #define LOCTEXT_NAMESPACE "FAwesomeAssetLoaderModule"
 
 void FAwesomeAssetLoaderModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+#if WITH_EDITOR
+	// Library files are written before packaging so they are staged with the build
+	CookStartedHandle = UE::Cook::FDelegates::CookByTheBookStarted.AddLambda([](UE::Cook::ICookInfo&)
+	{
+		FItemLibraryArchive::BuildCookedLibraries();
+	});
+#endif
 }
 
 void FAwesomeAssetLoaderModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+#if WITH_EDITOR
+	UE::Cook::FDelegates::CookByTheBookStarted.Remove(CookStartedHandle);
+#endif
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,9 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AwesomeAssetLoaderSettings.h"
+#include "Misc/Paths.h"
+
+FString UAwesomeAssetLoaderSettings::GetLibraryFilePath(FName LibraryName) const
+{
+	return FPaths::Combine(FPaths::ProjectContentDir(), OutputDirectory, LibraryName.ToString() + TEXT(".aaml"));
+}
@@ -3,6 +3,13 @@
 
 #include "AwesomeAssetManager.h"
 #include "Async/TaskGraphInterfaces.h"
+#include "Async/ParallelFor.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "ItemLibraryArchive.h"
+#include "AwesomeAssetLoaderSettings.h"
+#include "ScratchPool.h"
+#include "QueryPlan.h"
+#include "PackedSortKeys.h"
 
 
 DEFINE_LOG_CATEGORY(FLogAwesomeAssetManager);
@@ -11,76 +18,341 @@ bool UAwesomeAssetManager::AddAssetLibrary(FName LibraryName, TSet<FAssetInitial
 {
 	if (!LibraryName.IsNone() && !Assets.IsEmpty())
 	{
-		TSharedPtr<FItemLibrary> NewLibrary = MakeShared<FItemLibrary>();
+		const TSharedRef<FItemLibrary> NewLibrary = MakeShared<FItemLibrary>();
 		NewLibrary->Initialize(LibraryName, MoveTemp(Assets));
-		Libraries.Emplace(LibraryName, NewLibrary);
-		return true;
+		return AddLibrary(NewLibrary);
 	}
 
 	UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add a new asset library"))
 	return false;
 }
 
-void UAwesomeAssetManager::FilterAndSortAssets(FName LibraryName, const FFilterAndSortCriterion& Criterion, FSimpleDelegate OnComplete, bool bAllowAsynchronous)
+bool UAwesomeAssetManager::BuildAssetLibrary(FName LibraryName, FItemLibraryBuilder&& Builder, FSimpleDelegate OnComplete)
+{
+	if (LibraryName.IsNone() || Builder.Num() == 0)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add a new asset library"))
+		return false;
+	}
+
+	// Everything but adding the library is done on a worker thread
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis = TWeakObjectPtr<UAwesomeAssetManager>(this), LibraryName, Assets = MoveTemp(Builder.Assets), OnComplete]() mutable
+	{
+		BuildLibraryInternal(WeakThis, LibraryName, MoveTemp(Assets), OnComplete);
+	});
+	return true;
+}
+
+bool UAwesomeAssetManager::AddAssetLibraryFromFile(FName LibraryName, const FString& FilePath)
+{
+	if (LibraryName.IsNone())
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add a new asset library"))
+		return false;
+	}
+	
+	const TSharedPtr<FItemLibrary> NewLibrary = FItemLibraryArchive::Load(LibraryName, FilePath);
+	if (!NewLibrary)
+	{
+		return false;
+	}
+	
+	return AddLibrary(NewLibrary.ToSharedRef());
+}
+
+bool UAwesomeAssetManager::AddCookedAssetLibrary(FName LibraryName)
+{
+	return AddAssetLibraryFromFile(LibraryName, GetDefault<UAwesomeAssetLoaderSettings>()->GetLibraryFilePath(LibraryName));
+}
+
+bool UAwesomeAssetManager::SaveAssetLibrary(FName LibraryName, const FString& FilePath)
 {
-	TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
 	if (!Library)
 	{
-		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to find asset library to sort with name: %s"), *LibraryName.ToString());
-		return;
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	return FItemLibraryArchive::Save(*Library, FilePath);
+}
+
+bool UAwesomeAssetManager::AddItemsToLibrary(FName LibraryName, TArray<FAssetInitializeData> Assets)
+{
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	FItemLibraryChanges Changes;
+	Changes.Added = MoveTemp(Assets);
+	ApplyLibraryChanges(*Library, MoveTemp(Changes));
+	return true;
+}
+
+bool UAwesomeAssetManager::RemoveItemsFromLibrary(FName LibraryName, const TArray<FName>& UniqueIds)
+{
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	FItemLibraryChanges Changes;
+	Changes.Removed.Reserve(UniqueIds.Num());
+	for (const FName& UniqueId : UniqueIds)
+	{
+		const int32 ItemIndex = Library->FindItem(UniqueId);
+		if (ItemIndex == INDEX_NONE)
+		{
+			UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find asset %s in library %s"), *UniqueId.ToString(), *LibraryName.ToString())
+			continue;
+		}
+		Changes.Removed.AddUnique(ItemIndex);
 	}
 	
-	if (bAllowAsynchronous)
+	ApplyLibraryChanges(*Library, MoveTemp(Changes));
+	return true;
+}
+
+bool UAwesomeAssetManager::UpdateItemDescription(FName LibraryName, FName UniqueId, const TMap<FGameplayTag, float>& AssetDescriptions)
+{
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	const int32 ItemIndex = Library->FindItem(UniqueId);
+	if (ItemIndex == INDEX_NONE)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find asset %s in library %s"), *UniqueId.ToString(), *LibraryName.ToString())
+		return false;
+	}
+
+	FItemLibraryChanges Changes;
+	Changes.Updated.Emplace(ItemIndex, AssetDescriptions);
+	ApplyLibraryChanges(*Library, MoveTemp(Changes));
+	return true;
+}
+
+void UAwesomeAssetManager::BuildLibraryInternal(const TWeakObjectPtr<UAwesomeAssetManager>& WeakThis, FName LibraryName, TArray<FAssetInitializeData>&& Assets, FSimpleDelegate OnComplete)
+{
+	const TSharedRef<FItemLibrary> NewLibrary = MakeShared<FItemLibrary>();
+	NewLibrary->Initialize(LibraryName, MoveTemp(Assets));
+	
+	FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, NewLibrary, OnComplete]()
+	{
+		if (UAwesomeAssetManager* Manager = WeakThis.Get(); Manager && Manager->AddLibrary(NewLibrary))
+		{
+			UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Library %s was built with %i items"), *NewLibrary->Name.ToString(), NewLibrary->Items.Num())
+			OnComplete.ExecuteIfBound();
+		}
+	}, TStatId{}, nullptr, ENamedThreads::GameThread);
+}
+
+bool UAwesomeAssetManager::AddAssetLibraryFromDataTable(FName LibraryName, const UDataTable* DataTable, FOnAssetLibraryBuilt OnComplete)
+{
+	// Rows are copied here since the table can not be read from another thread
+	FItemLibraryBuilder Builder;
+	if (!DataTable || !Builder.AddRows(*DataTable))
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add asset library %s. The data table must have FAwesomeAssetRow rows."), *LibraryName.ToString())
+		return false;
+	}
+	
+	return BuildAssetLibrary(LibraryName, MoveTemp(Builder), FSimpleDelegate::CreateLambda([LibraryName, OnComplete]()
+	{
+		OnComplete.ExecuteIfBound(LibraryName);
+	}));
+}
+
+bool UAwesomeAssetManager::AddAssetLibraryFromAssetRegistry(FName LibraryName, const FARFilter& Filter, const TMap<FName, FGameplayTag>& DescriptionTags, FOnAssetLibraryBuilt OnComplete)
+{
+	TArray<FAssetData> FoundAssets;
+	IAssetRegistry::GetChecked().GetAssets(Filter, FoundAssets);
+	if (LibraryName.IsNone() || FoundAssets.IsEmpty())
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add asset library %s. The asset registry query found no assets."), *LibraryName.ToString())
+		return false;
+	}
+
+	// Turning the assets into items happens on the worker thread too
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis = TWeakObjectPtr<UAwesomeAssetManager>(this), LibraryName, FoundAssets = MoveTemp(FoundAssets), DescriptionTags, OnComplete]()
 	{
-		// Asynchronous
-		const int32 TaskNumber = Library->TaskCounter.fetch_add(1) + 1;
-		Library->SortAndFilterTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [TaskNumber, Library, Criterion, OnComplete]()
-		{
-			if (Library && TaskNumber == Library->TaskCounter.load()) // Still relevant?
-			{
-				// Lock just to copy the current values;
-				Library->Lock.Lock();
-				TSet<TSharedPtr<FAwesomeAssetData>> Items = Library->Items;
-				const FGameplayTagContainer MustHaveTagsCache = Library->MustHaveTagsCache;
-				const FGameplayTagContainer MustNotHaveTagsCache = Library->MustNotHaveTagsCache;
-				Library->Lock.Unlock();
-				
-				TSet<TSharedPtr<FAwesomeAssetData>> FilteredAssets;
-				TArray<TSharedPtr<FAwesomeAssetData>> SortedAssets;
-				FilterAndSortAssetsInternal(Items, MustHaveTagsCache, MustNotHaveTagsCache, Criterion, FilteredAssets, SortedAssets);
-
-				// Check if result is still relevant
-				if (TaskNumber == Library->TaskCounter.load())
+		FItemLibraryBuilder Builder;
+		Builder.Reserve(FoundAssets.Num());
+		for (const FAssetData& AssetData : FoundAssets)
+		{
+			// The object path, since a package can hold more than one asset
+			const FSoftObjectPath ObjectPath = AssetData.GetSoftObjectPath();
+			FAssetInitializeData& Asset = Builder.AddItem(FName(ObjectPath.ToString()));
+			Asset.SoftObjectPaths.Emplace(ObjectPath);
+			for (const TPair<FName, FGameplayTag>& DescriptionTag : DescriptionTags)
+			{
+				FString TagValue;
+				if (AssetData.GetTagValue(DescriptionTag.Key, TagValue))
 				{
-					FScopeLock Lock(&Library->Lock);
-					Library->FilteredAssets = MoveTemp(FilteredAssets);
-					Library->SortedAssets = MoveTemp(SortedAssets);
-					
-					FFunctionGraphTask::CreateAndDispatchWhenReady([Library, TaskNumber, OnComplete]()
-					{
-						// Only call if still relevant
-						if (Library && TaskNumber == Library->TaskCounter.load())
-						{
-							OnComplete.ExecuteIfBound();
-						}
-					}, TStatId{}, nullptr, ENamedThreads::GameThread);
+					float Value = 0.f;
+					LexTryParseString(Value, *TagValue);
+					Asset.AssetDescriptions.Emplace(DescriptionTag.Value, Value);
 				}
 			}
-		});
+		}
+
+		BuildLibraryInternal(WeakThis, LibraryName, MoveTemp(Builder.Assets), FSimpleDelegate::CreateLambda([LibraryName, OnComplete]()
+		{
+			OnComplete.ExecuteIfBound(LibraryName);
+		}));
+	});
+	return true;
+}
+
+void UAwesomeAssetManager::FilterAndSortAssets(FName LibraryName, const FFilterAndSortCriterion& Criterion, FSimpleDelegate OnComplete, bool bAllowAsynchronous)
+{
+	TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to find asset library to sort with name: %s"), *LibraryName.ToString());
+		return;
+	}
+	
+	if (bAllowAsynchronous && View->DebounceSeconds > 0.f)
+	{
+		// Whatever is running is superseded right away, but the work only starts once the window has passed, with the latest criterion
+		++View->TaskCounter;
+		View->InFlightCriterion.Reset();
+		View->InFlightOnComplete.Unbind();
+		View->DebouncedCriterion = Criterion;
+		View->DebouncedOnComplete = OnComplete;
+		if (View->DebounceTickerHandle.IsValid())
+		{
+			++View->NumCoalescedRequests;
+			return;
+		}
+		
+		const TWeakPtr<FLibraryView> WeakView = View;
+		View->DebounceTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakView](float)
+		{
+			if (const TSharedPtr<FLibraryView> DebouncedView = WeakView.Pin())
+			{
+				DebouncedView->DebounceTickerHandle.Reset();
+				LaunchFilterAndSort(DebouncedView.ToSharedRef(), DebouncedView->DebouncedCriterion, MoveTemp(DebouncedView->DebouncedOnComplete));
+			}
+			return false;
+		}), View->DebounceSeconds);
+		return;
+	}
+	
+	// A request still waiting out its debounce window is older than this one
+	if (View->DebounceTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(View->DebounceTickerHandle);
+		View->DebounceTickerHandle.Reset();
+		View->DebouncedOnComplete.Unbind();
+		++View->NumCoalescedRequests;
+	}
+	
+	if (bAllowAsynchronous)
+	{
+		LaunchFilterAndSort(View.ToSharedRef(), Criterion, OnComplete);
 	}
 	else
 	{
 		// Synchronous
-		FScopeLock Lock(&Library->Lock); // Blocking
-		++Library->TaskCounter;
-		FilterAndSortAssetsInternal(Library->Items, Library->MustHaveTagsCache, Library->MustNotHaveTagsCache, Criterion, Library->FilteredAssets, Library->SortedAssets );
-		Library->MustHaveTagsCache = Criterion.MustHaveTags;
-		Library->MustNotHaveTagsCache = Criterion.MustNotHaveTags;
-		UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Library %s has %i items after being filtered"), *Library->Name.ToString(), Library->FilteredAssets.Num())
+		const TSharedRef<FSortResult> NewResult = MakeShared<FSortResult>();
+		NewResult->Generation = ++View->TaskCounter;
+		View->InFlightCriterion.Reset();
+		View->InFlightOnComplete.Unbind();
+		const FItemLibrary& Library = *View->Library;
+		FilterAndSortAssetsInternal(*Library.Descriptions, *Library.QueryPlans, *View->GetResult(), Criterion, Library.ShouldFilterAndSortInParallel(), FSortCancellation(), *NewResult);
+		View->Result = NewResult;
+		View->RefreshBuffer();
+		UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Library view %s has %i items after being filtered"), *View->Name.ToString(), NewResult->FilteredAssets->Num())
 		OnComplete.ExecuteIfBound();
 	}
 }
 
+void UAwesomeAssetManager::LaunchFilterAndSort(const TSharedRef<FLibraryView>& View, const FFilterAndSortCriterion& Criterion, FSimpleDelegate OnComplete)
+{
+	// The descriptions and the previous result are immutable so they are read in place, even from a task.
+	// The library is held on to as well since the view points back at it.
+	const TSharedRef<FItemLibrary> Library = View->Library->AsShared();
+	const TSharedRef<const FItemDescriptionTable> Descriptions = Library->Descriptions.ToSharedRef();
+	const TSharedRef<FQueryPlanCache> QueryPlans = Library->QueryPlans.ToSharedRef();
+	const TSharedRef<const FSortResult> Previous = View->GetResult();
+	const bool bParallel = Library->ShouldFilterAndSortInParallel();
+	const int32 NumLazySorted = View->bLazySort ? View->GetNumLazySorted() : 0;
+	
+	const int32 TaskNumber = View->TaskCounter.fetch_add(1) + 1;
+	View->InFlightCriterion = Criterion;
+	View->InFlightOnComplete = OnComplete;
+	View->SortAndFilterTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [TaskNumber, View, Library, Descriptions, QueryPlans, Previous, Criterion, bParallel, NumLazySorted, OnComplete]()
+	{
+		LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+		FScratchPool::FScope Scratch;
+		
+		// The work checks this as it goes and stops once a newer request comes in
+		FSortCancellation Cancellation;
+		Cancellation.TaskCounter = &View->TaskCounter;
+		Cancellation.TaskNumber = TaskNumber;
+
+		const auto OnPublished = [View, Library, TaskNumber](const FSimpleDelegate& OnPublishedComplete)
+		{
+			FFunctionGraphTask::CreateAndDispatchWhenReady([View, Library, TaskNumber, OnPublishedComplete]()
+			{
+				// Only call if still relevant
+				if (TaskNumber == View->TaskCounter.load())
+				{
+					View->InFlightCriterion.Reset();
+					View->InFlightOnComplete.Unbind();
+
+					// The buffer kept loading against the previous result while this was sorting
+					View->RefreshBuffer();
+					OnPublishedComplete.ExecuteIfBound();
+				}
+			}, TStatId{}, nullptr, ENamedThreads::GameThread);
+		};
+		
+		TUniquePtr<FSortResult> NewResult = MakeUnique<FSortResult>();
+		NewResult->Generation = TaskNumber;
+		if (Cancellation.IsCancelled() || !FilterAssetsInternal(*Descriptions, *QueryPlans, *Previous, Criterion, bParallel, *Scratch, Cancellation, *NewResult))
+		{
+			++View->NumCancelledTasks;
+			return;
+		}
+
+		// When columns still have to be gathered, the start of the order is laid out and published first so the buffer can load it sooner
+		bool bCompletedEarly = false;
+		if (NumLazySorted > 0 && !Criterion.UsesSortKeys())
+		{
+			TArray<int32> SortColumns;
+			ResolveSortColumns(*Descriptions, Criterion.SortOrder, SortColumns);
+			if (SortColumns.ContainsByPredicate([&NewResult](const int32 Column) { return Column != INDEX_NONE && !NewResult->SortedColumnCache.Contains(Column); }))
+			{
+				TUniquePtr<FSortResult> FirstResult = MakeUnique<FSortResult>(*NewResult);
+				FLazySortState::Begin(Descriptions, SortColumns, Criterion.bSortValuesDescending, NumLazySorted, *FirstResult);
+				View->PublishResult(MoveTemp(FirstResult));
+				OnPublished(OnComplete);
+				bCompletedEarly = true;
+			}
+		}
+		
+		if (!SortAssetsInternal(*Descriptions, bParallel, *Scratch, Cancellation, *NewResult) || Cancellation.IsCancelled())
+		{
+			++View->NumCancelledTasks;
+			return;
+		}
+		
+		View->PublishResult(MoveTemp(NewResult));
+		OnPublished(bCompletedEarly ? FSimpleDelegate() : OnComplete);
+	});
+}
+
 void UAwesomeAssetManager::K2_FilterAndSortAssets(FName LibraryName, const FFilterAndSortCriterion& Criterion, FOnFilteredAndSorted OnComplete, bool bAllowAsynchronous)
 {
 	FilterAndSortAssets(LibraryName, Criterion, FSimpleDelegate::CreateUFunction(OnComplete.GetUObject(), OnComplete.GetFunctionName()), bAllowAsynchronous);
@@ -88,35 +360,74 @@ void UAwesomeAssetManager::K2_FilterAndSortAssets(FName LibraryName, const FFilt
 
 bool UAwesomeAssetManager::GetSortedAssets(FName LibraryName, TArray<FName>& SortedAssets)
 {
-	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
-	if (!Library)
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
 	{
 		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
 		return false;
 	}
 
-	verify(Library->SortAndFilterTask.Wait());
-	FScopeLock Lock(&Library->Lock);
-	SortedAssets.Empty(Library->SortedAssets.Num());
-	for (const auto Asset : Library->SortedAssets)
+	// Every item is asked for, so a lazily sorted order is laid out in full
+	const TSharedRef<const FSortResult> Result = View->EnsureSorted(View->GetResult(), MAX_int32);
+	SortedAssets.Empty(Result->SortedAssets.Num());
+	for (const int32 ItemIndex : Result->SortedAssets)
 	{
-		if (Asset.IsValid())
-		{
-			SortedAssets.Emplace(Asset->UniqueId);
-		}
+		SortedAssets.Emplace(View->Library->Items[ItemIndex].UniqueId);
 	}
 	
 	return true;
 }
 
-bool UAwesomeAssetManager::SetBufferTarget(TSharedPtr<FItemLibrary> Library, const int32 TargetStart, const int32 TargetEnd, const int32 BufferSize)
+bool UAwesomeAssetManager::GetSortedAssetView(FName LibraryName, const int32 Start, const int32 Count, FSortedAssetView& OutView)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	OutView = FSortedAssetView(*View, Start, Count);
+	return true;
+}
+
+bool UAwesomeAssetManager::GetSortedAssetRange(FName LibraryName, const int32 Start, const int32 Count, TArray<FName>& SortedAssets, int32& NumSorted, int32& Generation)
+{
+	FSortedAssetView View;
+	if (!GetSortedAssetView(LibraryName, Start, Count, View))
+	{
+		return false;
+	}
+
+	// Reset keeps the capacity of an array the caller reuses between refreshes
+	SortedAssets.Reset(View.Num());
+	for (int32 Index = 0; Index < View.Num(); ++Index)
+	{
+		SortedAssets.Emplace(View[Index]);
+	}
+	NumSorted = View.GetNumSorted();
+	Generation = View.GetGeneration();
+	return true;
+}
+
+int32 UAwesomeAssetManager::GetSortedAssetsGeneration(FName LibraryName)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return INDEX_NONE;
+	}
+
+	return View->GetResult()->Generation;
+}
+
+bool UAwesomeAssetManager::SetBufferTarget(TSharedPtr<FLibraryView> View, const int32 TargetStart, const int32 TargetEnd, const int32 BufferSize)
 {
-	if (Library)
+	if (View)
 	{
-		Library->BufferSize = BufferSize;
-		Library->TargetStart = TargetStart;
-		Library->TargetEnd = TargetEnd;
-		UpdateBuffer(Library);
+		View->SetBufferTarget(TargetStart, TargetEnd, BufferSize);
+		UpdateBuffer(View);
 		return true;
 	}
 	
@@ -125,46 +436,64 @@ bool UAwesomeAssetManager::SetBufferTarget(TSharedPtr<FItemLibrary> Library, con
 
 bool UAwesomeAssetManager::SetBufferTargetByIndex(FName LibraryName, const int32 AssetIndex, const int32 CoreExtent, const int32 BufferSize)
 {
-	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
-	if (!Library)
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
 	{
 		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
 		return false;
 	}
 
+	const int32 NumSorted = View->GetResult()->NumSorted;
 	const int32 StartTarget = AssetIndex - CoreExtent < 0 ? 0 : AssetIndex - CoreExtent;
-	const int32 EndTarget = AssetIndex + CoreExtent >= Library->SortedAssets.Num() ? Library->SortedAssets.Num() - 1 : AssetIndex + CoreExtent;
-	return SetBufferTarget(Library, StartTarget, EndTarget, BufferSize);
+	const int32 EndTarget = AssetIndex + CoreExtent >= NumSorted ? NumSorted - 1 : AssetIndex + CoreExtent;
+	return SetBufferTarget(View, StartTarget, EndTarget, BufferSize);
 }
 
 bool UAwesomeAssetManager::SetBufferTargetByUniqueId(FName LibraryName, FName UniqueId, const int32 CoreExtent, const int32 BufferSize)
 {
-	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
-	if (!Library)
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
 	{
 		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
 		return false;
 	}
-	
-	for (int i = 0; i < Library->SortedAssets.Num(); ++i)
+
+	const int32 ItemIndex = View->Library->FindItem(UniqueId);
+	if (ItemIndex == INDEX_NONE)
 	{
-		if (Library->SortedAssets[i]->UniqueId == UniqueId)
-		{
-			const int32 StartTarget = i - CoreExtent < 0 ? 0 : i - CoreExtent;
-			const int32 EndTarget = i + CoreExtent > Library->SortedAssets.Num() - 1 ? Library->SortedAssets.Num() - 1 : i + CoreExtent;
-			SetBufferTarget(Library, StartTarget, EndTarget, BufferSize);
-			return true;
-		}
+		return false;
 	}
 	
-	return false;
+	const int32 SortedIndex = View->FindSortedPosition(ItemIndex);
+	if (SortedIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const int32 NumSorted = View->GetResult()->NumSorted;
+	const int32 StartTarget = SortedIndex - CoreExtent < 0 ? 0 : SortedIndex - CoreExtent;
+	const int32 EndTarget = SortedIndex + CoreExtent > NumSorted - 1 ? NumSorted - 1 : SortedIndex + CoreExtent;
+	return SetBufferTarget(View, StartTarget, EndTarget, BufferSize);
+}
+
+int32 UAwesomeAssetManager::GetSortedIndexByUniqueId(FName LibraryName, FName UniqueId)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return INDEX_NONE;
+	}
+
+	const int32 ItemIndex = View->Library->FindItem(UniqueId);
+	return ItemIndex != INDEX_NONE ? View->FindSortedPosition(ItemIndex) : INDEX_NONE;
 }
 
 bool UAwesomeAssetManager::SetBufferTargetByPage(FName LibraryName, const int32 PageIndex, const int32 PageSize, const int32 NumBufferPages)
 {
-	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
 
-	if (!Library)
+	if (!View)
 	{
 		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
 		return false;
@@ -174,75 +503,776 @@ bool UAwesomeAssetManager::SetBufferTargetByPage(FName LibraryName, const int32
 	const int32 EndIndex = StartIndex + PageSize - 1;
 	
 	const int32 BufferSize = NumBufferPages * PageSize;
-	return SetBufferTarget(Library, StartIndex, EndIndex, BufferSize);
+	return SetBufferTarget(View, StartIndex, EndIndex, BufferSize);
 }
 
-void UAwesomeAssetManager::FilterAndSortAssetsInternal(const TSet<TSharedPtr<FAwesomeAssetData>>& Items, const FGameplayTagContainer& MushHaveTagsCache, const FGameplayTagContainer& MushNotHaveTagsCache, const FFilterAndSortCriterion& Criterion, TSet<TSharedPtr<FAwesomeAssetData>>& FilteredAssets, TArray<TSharedPtr<FAwesomeAssetData>>& SortedAssets)
+bool UAwesomeAssetManager::AddLibraryView(FName LibraryName, FName ViewName)
 {
-	// Filter
-	if (Criterion.MustHaveTags != MushHaveTagsCache || Criterion.MustNotHaveTags != MushNotHaveTagsCache)
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
 	{
-		FilteredAssets.Reserve(Items.Num());
-		
-		for (const auto& Item : Items)
-		{
-			// This might be a good place for a gameplay tag query 
-			if (Item->CachedAssetDescriptionTags.HasAll(Criterion.MustHaveTags) && !Item->CachedAssetDescriptionTags.HasAny(Criterion.MustNotHaveTags))
-			{
-				FilteredAssets.Emplace(Item);
-			}
-		}
-		FilteredAssets = MoveTemp(FilteredAssets);
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
 	}
-	else
+
+	if (ViewName.IsNone() || Views.Contains(ViewName))
 	{
-		UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Filter caches match new filter request. Skipping filtering"))
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add a view of name %s to library %s. The name is taken."), *ViewName.ToString(), *LibraryName.ToString())
+		return false;
 	}
 
-	// Sort
-	// todo get rid of moving the data and just sort it from the beginning.
-	SortedAssets.Reset(FilteredAssets.Num()); 
-	TArray<TArray<TSharedPtr<FAwesomeAssetData>>> SortBuckets;
-	SortBuckets.Init(TArray<TSharedPtr<FAwesomeAssetData>>(), Criterion.SortOrder.Num());
-	
-	for (const auto& Item : FilteredAssets)
+	Views.Emplace(ViewName, Library->AddView(ViewName));
+	return true;
+}
+
+bool UAwesomeAssetManager::RemoveLibraryView(FName ViewName)
+{
+	const TSharedPtr<FLibraryView> View = GetView(ViewName);
+	if (!View)
 	{
-		for (int32 i = 0; i < Criterion.SortOrder.Num(); ++i)
-		{
-			// If current asset contains current tag.
-			if (Item->AssetDescriptions.Contains(Criterion.SortOrder[i]))
-			{
-				SortBuckets[i].Emplace(Item);
-				break;
-			}
-		}
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library view of name: %s"), *ViewName.ToString())
+		return false;
 	}
-	
-	// Sort by values in buckets.
-	for (int32 i = 0; i < SortBuckets.Num(); ++i)
+
+	if (View == View->Library->GetDefaultView())
 	{
-		const FGameplayTag ThisBucketsTag = Criterion.SortOrder[i];
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to remove view %s. A library's default view can not be removed."), *ViewName.ToString())
+		return false;
+	}
 
-		if (Criterion.bSortValuesDescending)
-		{
-			SortBuckets[i].Sort([ThisBucketsTag](const TSharedPtr<FAwesomeAssetData>& A, const TSharedPtr<FAwesomeAssetData>& B)
-			{
-				return A->AssetDescriptions.FindChecked(ThisBucketsTag) > B->AssetDescriptions.FindChecked(ThisBucketsTag);
-			});
-		}
-		else
-		{
-			SortBuckets[i].Sort([ThisBucketsTag](const TSharedPtr<FAwesomeAssetData>& A, const TSharedPtr<FAwesomeAssetData>& B)
-			{
-				return A->AssetDescriptions.FindChecked(ThisBucketsTag) < B->AssetDescriptions.FindChecked(ThisBucketsTag);
-			});
-		}
-		
-		SortedAssets.Append(MoveTemp(SortBuckets[i]));
+	View->Library->RemoveView(View.ToSharedRef());
+	Views.Remove(ViewName);
+	return true;
+}
+
+bool UAwesomeAssetManager::SetParallelFilterAndSort(FName LibraryName, const EParallelFilterAndSort Mode)
+{
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
 	}
+
+	Library->ParallelFilterAndSort = Mode;
+	return true;
+}
+
+bool UAwesomeAssetManager::SetPredictivePrefetch(FName LibraryName, const FPredictivePrefetchSettings& Settings)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	View->PredictiveSettings = Settings;
+	View->ScrollVelocity = 0.f;
+	return true;
+}
+
+bool UAwesomeAssetManager::SetLoadIssueBudget(FName LibraryName, const float BudgetMilliseconds)
+{
+	const TSharedPtr<FItemLibrary> Library = GetLibrary(LibraryName);
+	if (!Library)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	Library->IssueBudgetSeconds = FMath::Max(BudgetMilliseconds, 0.f) / 1000.f;
+	return true;
+}
+
+bool UAwesomeAssetManager::SetLazySort(FName LibraryName, const bool bEnabled)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	View->bLazySort = bEnabled;
+	return true;
+}
+
+bool UAwesomeAssetManager::GetNumSortedAssets(FName LibraryName, int32& NumSorted, bool& bFullyOrdered)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	const TSharedRef<const FSortResult>& Result = View->GetResult();
+	NumSorted = Result->NumSorted;
+	bFullyOrdered = Result->IsComplete();
+	return true;
+}
+
+bool UAwesomeAssetManager::SetFilterAndSortDebounce(FName LibraryName, const float DebounceMilliseconds)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	View->DebounceSeconds = FMath::Max(DebounceMilliseconds, 0.f) / 1000.f;
+	return true;
+}
+
+bool UAwesomeAssetManager::GetFilterAndSortStats(FName LibraryName, int32& NumCancelledTasks, int32& NumCoalescedRequests)
+{
+	const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+	if (!View)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Log, TEXT("Failed to find a library of name: %s"), *LibraryName.ToString())
+		return false;
+	}
+
+	NumCancelledTasks = View->NumCancelledTasks.load();
+	NumCoalescedRequests = View->NumCoalescedRequests;
+	return true;
+}
+
+void UAwesomeAssetManager::SetResidencyBudget(const int64 BudgetBytes)
+{
+	ResidencyCache->SetBudget(BudgetBytes);
+}
+
+int64 UAwesomeAssetManager::GetResidentBytes() const
+{
+	return ResidencyCache->GetResidentBytes();
+}
+
+void UAwesomeAssetManager::SetStatusDispatch(const FStatusDispatchSettings& Settings)
+{
+	StatusDispatcher->Settings = Settings;
+	StatusDispatcher->OnDelivered = [WeakThis = TWeakObjectPtr<UAwesomeAssetManager>(this)](FName LibraryName, const TArray<FName>& Loaded, const TArray<FName>& Unloaded)
+	{
+		if (UAwesomeAssetManager* Manager = WeakThis.Get())
+		{
+			Manager->OnStatusChangesDelivered.Broadcast(LibraryName, Loaded, Unloaded);
+		}
+	};
+}
+
+void UAwesomeAssetManager::GetPathStats(int32& NumPaths, int32& NumLoadedPaths) const
+{
+	NumPaths = PathRegistry->GetNumPaths();
+	NumLoadedPaths = PathRegistry->GetNumLoadedPaths();
+}
+
+void UAwesomeAssetManager::GetScratchStats(int64& NumScratchGrows, int64& ScratchBytes) const
+{
+	NumScratchGrows = FScratchPool::Get().GetNumGrows();
+	ScratchBytes = FScratchPool::Get().GetAllocatedBytes();
+}
+
+bool UAwesomeAssetManager::FilterAndSortAssetsInternal(const FItemDescriptionTable& Descriptions, FQueryPlanCache& QueryPlans, const FSortResult& Previous, const FFilterAndSortCriterion& Criterion, const bool bParallel, const FSortCancellation& Cancellation, FSortResult& Result)
+{
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+	FScratchPool::FScope Scratch;
+	return FilterAssetsInternal(Descriptions, QueryPlans, Previous, Criterion, bParallel, *Scratch, Cancellation, Result)
+		&& SortAssetsInternal(Descriptions, bParallel, *Scratch, Cancellation, Result);
+}
+
+bool UAwesomeAssetManager::FilterAssetsInternal(const FItemDescriptionTable& Descriptions, FQueryPlanCache& QueryPlans, const FSortResult& Previous, const FFilterAndSortCriterion& Criterion, const bool bParallel, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, FSortResult& Result)
+{
+	Result.Criterion = Criterion;
+	
+	// Filter
+	Result.Filter = FTagMaskFilter::Compile(Descriptions, Criterion.MustHaveTags, Criterion.MustNotHaveTags);
+	if (!Criterion.Query.IsEmpty())
+	{
+		Result.QueryPlan = QueryPlans.FindOrCompile(Descriptions, Criterion.Query);
+	}
+	
+	const bool bSameQuery = Result.QueryPlan == Previous.QueryPlan
+		|| (Result.QueryPlan && Previous.QueryPlan && Result.QueryPlan->GetQuery() == Previous.QueryPlan->GetQuery());
+	TArray<int32> AddedClauses;
+	if (Result.Filter != Previous.Filter || !bSameQuery)
+	{
+		const TSharedRef<TArray<int32>> NewFilteredAssets = MakeShared<TArray<int32>>();
+		if (Result.Filter == Previous.Filter && Result.QueryPlan && !Previous.QueryPlan)
+		{
+			// A query was added, so only what passed the tag filter before has to be checked
+			*NewFilteredAssets = *Previous.FilteredAssets;
+			Result.QueryPlan->Refine(Descriptions, *NewFilteredAssets, &Cancellation);
+		}
+		else if (Result.Filter == Previous.Filter && Result.QueryPlan && Result.QueryPlan->GetAddedClauses(*Previous.QueryPlan, AddedClauses))
+		{
+			// The query was narrowed down, so only what passed before has to be checked and only against the added clauses
+			*NewFilteredAssets = *Previous.FilteredAssets;
+			Result.QueryPlan->RefineByClauses(Descriptions, AddedClauses, *NewFilteredAssets, &Cancellation);
+		}
+		else
+		{
+			if (bParallel)
+			{
+				Result.Filter.EvaluateParallel(Descriptions, FItemLibrary::ParallelChunkSize, *Scratch, *NewFilteredAssets, &Cancellation);
+			}
+			else
+			{
+				Result.Filter.Evaluate(Descriptions, *NewFilteredAssets, &Cancellation);
+			}
+			
+			// The query only sees what the tag filter let through
+			if (Result.QueryPlan && bParallel)
+			{
+				Result.QueryPlan->RefineParallel(Descriptions, FItemLibrary::ParallelChunkSize, *Scratch, *NewFilteredAssets, &Cancellation);
+			}
+			else if (Result.QueryPlan)
+			{
+				Result.QueryPlan->Refine(Descriptions, *NewFilteredAssets, &Cancellation);
+			}
+		}
+		Result.FilteredAssets = NewFilteredAssets;
+		
+		// A cancelled filter stops part way, so what it has is not a result
+		if (Cancellation.IsCancelled())
+		{
+			return false;
+		}
+	}
+	else
+	{
+		UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Filter caches match new filter request. Skipping filtering"))
+		
+		// Sorted columns are only valid for the items they were built from so only carry them over when the filter result is the same
+		Result.FilteredAssets = Previous.FilteredAssets;
+		Result.SortedColumnCache = Previous.SortedColumnCache;
+	}
+	return true;
+}
+
+bool UAwesomeAssetManager::SortAssetsInternal(const FItemDescriptionTable& Descriptions, const bool bParallel, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, FSortResult& Result)
+{
+	const TArray<int32>& FilteredAssets = *Result.FilteredAssets;
+	FSortedColumnCache& SortedColumnCache = Result.SortedColumnCache;
+
+	// Composite sorts pack their keys straight from the table's pre-sorted columns, so they do not need the cached ones
+	if (Result.Criterion.UsesSortKeys())
+	{
+		if (!FPackedSortKeys::Sort(Descriptions, Result.Criterion, FilteredAssets, Scratch, Cancellation, Result.SortedAssets))
+		{
+			return false;
+		}
+		FinishSortedAssets(Descriptions, Result);
+		return true;
+	}
+
+	TArray<int32> SortColumns;
+	ResolveSortColumns(Descriptions, Result.Criterion.SortOrder, SortColumns);
+
+	// Columns that have not been used since the filter changed are gathered from the pre-sorted columns, keeping only filtered items
+	TBitArray<>& FilteredBits = Scratch.FilteredBits;
+	bool bHasFilteredBits = false;
+	for (const int32 Column : SortColumns)
+	{
+		if (Cancellation.IsCancelled())
+		{
+			return false;
+		}
+		
+		if (Column != INDEX_NONE && !SortedColumnCache.Contains(Column))
+		{
+			if (!bHasFilteredBits)
+			{
+				// Reset rather than Init, which would reallocate whenever the size differs
+				bHasFilteredBits = true;
+				FilteredBits.Reset();
+				FilteredBits.Add(false, Descriptions.NumItems);
+				for (const int32 ItemIndex : FilteredAssets)
+				{
+					FilteredBits[ItemIndex] = true;
+				}
+			}
+			
+			TSharedRef<TArray<int32>> SortedColumn = MakeShared<TArray<int32>>();
+			if (bParallel)
+			{
+				GatherSortedColumnParallel(Descriptions.SortedColumns[Column], FilteredBits, Scratch, *SortedColumn);
+			}
+			else
+			{
+				SortedColumn->Reserve(FMath::Min(FilteredAssets.Num(), Descriptions.SortedColumns[Column].Num()));
+				for (const FColumnEntry& Entry : Descriptions.SortedColumns[Column])
+				{
+					if (FilteredBits[Entry.ItemIndex])
+					{
+						SortedColumn->Emplace(Entry.ItemIndex);
+					}
+				}
+			}
+			SortedColumnCache.Emplace(Column, MoveTemp(SortedColumn));
+		}
+	}
+
+	if (Cancellation.IsCancelled())
+	{
+		return false;
+	}
+	
+	ComposeSortedAssets(Descriptions, SortColumns, Result.Criterion.bSortValuesDescending, Result);
+	return true;
+}
+
+void UAwesomeAssetManager::ResolveSortColumns(const FItemDescriptionTable& Descriptions, const TArray<FGameplayTag>& SortOrder, TArray<int32>& SortColumns)
+{
+	// Tags no item uses can never hold anything
+	SortColumns.Reset(SortOrder.Num());
+	for (const FGameplayTag& Tag : SortOrder)
+	{
+		SortColumns.Emplace(Descriptions.FindColumn(Tag));
+	}
+}
+
+void UAwesomeAssetManager::ComposeSortedAssets(const FItemDescriptionTable& Descriptions, const TArray<int32>& SortColumns, const bool bDescending, FSortResult& Result)
+{
+	const TArray<int32>& FilteredAssets = *Result.FilteredAssets;
+	const FSortedColumnCache& SortedColumnCache = Result.SortedColumnCache;
+	TArray<int32>& SortedAssets = Result.SortedAssets;
+
+	// Each item goes in the bucket of the first sort tag it has. Walking the ascending columns forwards or backwards gives each bucket in order.
+	SortedAssets.Reset(FilteredAssets.Num());
+	for (int32 i = 0; i < SortColumns.Num(); ++i)
+	{
+		if (SortColumns[i] == INDEX_NONE)
+		{
+			continue;
+		}
+		
+		const TArray<int32>& SortedColumn = *SortedColumnCache.FindChecked(SortColumns[i]);
+		const auto BelongsInBucket = [&Descriptions, &SortColumns, i](const int32 ItemIndex)
+		{
+			for (int32 Earlier = 0; Earlier < i; ++Earlier)
+			{
+				if (SortColumns[Earlier] != INDEX_NONE && Descriptions.HasColumn(ItemIndex, SortColumns[Earlier]))
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		if (bDescending)
+		{
+			for (int32 Position = SortedColumn.Num() - 1; Position >= 0; --Position)
+			{
+				if (BelongsInBucket(SortedColumn[Position]))
+				{
+					SortedAssets.Emplace(SortedColumn[Position]);
+				}
+			}
+		}
+		else
+		{
+			for (const int32 ItemIndex : SortedColumn)
+			{
+				if (BelongsInBucket(ItemIndex))
+				{
+					SortedAssets.Emplace(ItemIndex);
+				}
+			}
+		}
+	}
+
+	FinishSortedAssets(Descriptions, Result);
+}
+
+void UAwesomeAssetManager::FinishSortedAssets(const FItemDescriptionTable& Descriptions, FSortResult& Result)
+{
+	const TArray<int32>& SortedAssets = Result.SortedAssets;
+	Result.NumSorted = SortedAssets.Num();
+	Result.LazyState.Reset();
+
+	// Positions of the items in the sorted order for constant time lookups
+	Result.SortedPositions.Init(INDEX_NONE, Descriptions.NumItems);
+	for (int32 Position = 0; Position < SortedAssets.Num(); ++Position)
+	{
+		Result.SortedPositions[SortedAssets[Position]] = Position;
+	}
+}
+
+void UAwesomeAssetManager::GatherSortedColumnParallel(const TConstArrayView<FColumnEntry> Entries, const TBitArray<>& FilteredBits, FFilterAndSortScratch& Scratch, TArray<int32>& SortedColumn)
+{
+	const int32 NumChunks = FMath::Max(1, FMath::DivideAndRoundUp(Entries.Num(), FItemLibrary::ParallelChunkSize));
+
+	// Each chunk of the pre-sorted column keeps its filtered items. Chunk arrays are never shrunk so they keep their capacity.
+	TArray<TArray<int32>>& Chunks = Scratch.Chunks;
+	if (Chunks.Num() < NumChunks)
+	{
+		Chunks.SetNum(NumChunks);
+	}
+	ParallelFor(NumChunks, [&Entries, &FilteredBits, &Chunks](const int32 Chunk)
+	{
+		const int32 Start = Chunk * FItemLibrary::ParallelChunkSize;
+		const int32 End = FMath::Min(Start + FItemLibrary::ParallelChunkSize, Entries.Num());
+		TArray<int32>& Items = Chunks[Chunk];
+		Items.Reset(End - Start);
+		for (int32 i = Start; i < End; ++i)
+		{
+			if (FilteredBits[Entries[i].ItemIndex])
+			{
+				Items.Emplace(Entries[i].ItemIndex);
+			}
+		}
+	});
+
+	// Chunks are already in order so lay each one out at its final position, allocating the result once
+	TArray<int32>& ChunkStarts = Scratch.ChunkStarts;
+	ChunkStarts.SetNumUninitialized(NumChunks, EAllowShrinking::No);
+	int32 NumSorted = 0;
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		ChunkStarts[Chunk] = NumSorted;
+		NumSorted += Chunks[Chunk].Num();
+	}
+
+	SortedColumn.SetNumUninitialized(NumSorted);
+	ParallelFor(NumChunks, [&Chunks, &ChunkStarts, &SortedColumn](const int32 Chunk)
+	{
+		FMemory::Memcpy(SortedColumn.GetData() + ChunkStarts[Chunk], Chunks[Chunk].GetData(), Chunks[Chunk].Num() * sizeof(int32));
+	});
+}
+
+void UAwesomeAssetManager::ApplyLibraryChanges(FItemLibrary& Library, FItemLibraryChanges&& Changes)
+{
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+	const FItemDescriptionTable& OldDescriptions = *Library.Descriptions;
+	const int32 FirstAdded = Library.Items.Num();
+
+	// Append the new items. Their descriptions go into the table below.
+	TArray<TMap<FGameplayTag, float>> AddedDescriptions;
+	AddedDescriptions.Reserve(Changes.Added.Num());
+	for (FAssetInitializeData& Asset : Changes.Added)
+	{
+		if (!Asset.UniqueId.IsNone())
+		{
+			if (Library.UniqueIdToItem.Contains(Asset.UniqueId))
+			{
+				UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library %s has more than one asset with the unique Id %s. Only the first can be found by Id."), *Library.Name.ToString(), *Asset.UniqueId.ToString());
+			}
+			else
+			{
+				Library.UniqueIdToItem.Emplace(Asset.UniqueId, Library.Items.Num());
+			}
+		}
+		AddedDescriptions.Emplace(MoveTemp(Asset.AssetDescriptions));
+		Library.Items.Emplace(MoveTemp(Asset), Library.ItemPaths);
+	}
+
+	for (const int32 ItemIndex : Changes.Removed)
+	{
+		FAwesomeAssetData& Item = Library.Items[ItemIndex];
+		Item.bRemoved = true;
+		if (!Item.UniqueId.IsNone() && Library.FindItem(Item.UniqueId) == ItemIndex)
+		{
+			Library.UniqueIdToItem.Remove(Item.UniqueId);
+		}
+	}
+
+	// Updates of removed items are dropped, including those removed above
+	Changes.Updated.RemoveAll([&Library](const TPair<int32, TMap<FGameplayTag, float>>& Update)
+	{
+		return Library.Items[Update.Key].bRemoved;
+	});
+
+	const int32 NumItems = Library.Items.Num();
+	for (const TSharedRef<FLibraryView>& View : Library.Views)
+	{
+		View->ItemBands.SetNumZeroed(NumItems);
+	}
+	
+	// Every view gets a new result, made from its latest one. That cancels tasks still running, which are started again below.
+	TArray<TSharedRef<FSortResult>, TInlineAllocator<4>> NewResults;
+	for (const TSharedRef<FLibraryView>& View : Library.Views)
+	{
+		const TSharedRef<FSortResult>& NewResult = NewResults.Emplace_GetRef(MakeShared<FSortResult>());
+		NewResult->Generation = ++View->TaskCounter;
+	}
+	TSharedPtr<FItemDescriptionTable> NewDescriptions;
+
+	// Without new tags the dictionary stays the same, so the table, the filter and the sorted columns can be patched in place of being rebuilt
+	bool bIncremental = true;
+	for (const TMap<FGameplayTag, float>& Description : AddedDescriptions)
+	{
+		bIncremental &= OldDescriptions.HasColumns(Description);
+	}
+	for (const TPair<int32, TMap<FGameplayTag, float>>& Update : Changes.Updated)
+	{
+		bIncremental &= OldDescriptions.HasColumns(Update.Value);
+	}
+
+	if (bIncremental)
+	{
+		// The old table may still be read by a task so the changes go into a copy, which only copies the parts the changes touch
+		NewDescriptions = MakeShared<FItemDescriptionTable>(OldDescriptions);
+		NewDescriptions->AddItems(AddedDescriptions.Num());
+		for (int32 Added = 0; Added < AddedDescriptions.Num(); ++Added)
+		{
+			NewDescriptions->UniqueIds.Edit()[FirstAdded + Added] = Library.Items[FirstAdded + Added].UniqueId;
+			NewDescriptions->SetDescription(FirstAdded + Added, AddedDescriptions[Added]);
+		}
+		for (const int32 ItemIndex : Changes.Removed)
+		{
+			NewDescriptions->RemoveItem(ItemIndex);
+		}
+		for (const TPair<int32, TMap<FGameplayTag, float>>& Update : Changes.Updated)
+		{
+			NewDescriptions->SetDescription(Update.Key, Update.Value);
+		}
+
+		// Every changed item is taken out of the previous results and put back if it passes their filter
+		TArray<int32> ChangedItems;
+		ChangedItems.Reserve(AddedDescriptions.Num() + Changes.Removed.Num() + Changes.Updated.Num());
+		TBitArray<> ChangedBits(false, NumItems);
+		const auto AddChanged = [&ChangedItems, &ChangedBits](const int32 ItemIndex)
+		{
+			if (!ChangedBits[ItemIndex])
+			{
+				ChangedBits[ItemIndex] = true;
+				ChangedItems.Emplace(ItemIndex);
+			}
+		};
+		for (int32 ItemIndex = FirstAdded; ItemIndex < NumItems; ++ItemIndex)
+		{
+			AddChanged(ItemIndex);
+		}
+		for (const int32 ItemIndex : Changes.Removed)
+		{
+			AddChanged(ItemIndex);
+		}
+		for (const TPair<int32, TMap<FGameplayTag, float>>& Update : Changes.Updated)
+		{
+			AddChanged(Update.Key);
+		}
+		ChangedItems.Sort();
+
+		for (int32 ViewIndex = 0; ViewIndex < Library.Views.Num(); ++ViewIndex)
+		{
+			PatchSortResult(*NewDescriptions, *Library.Views[ViewIndex]->GetResult(), ChangedItems, ChangedBits, Library.ShouldFilterAndSortInParallel(), *NewResults[ViewIndex]);
+		}
+	}
+	else
+	{
+		// New tags change the dictionary, so the table is built again from every description and the results filtered and sorted again
+		TArray<TMap<FGameplayTag, float>> ItemDescriptions;
+		ItemDescriptions.SetNum(NumItems);
+		for (int32 ItemIndex = 0; ItemIndex < FirstAdded; ++ItemIndex)
+		{
+			if (!Library.Items[ItemIndex].bRemoved)
+			{
+				OldDescriptions.GetDescription(ItemIndex, ItemDescriptions[ItemIndex]);
+			}
+		}
+		for (int32 Added = 0; Added < AddedDescriptions.Num(); ++Added)
+		{
+			ItemDescriptions[FirstAdded + Added] = MoveTemp(AddedDescriptions[Added]);
+		}
+		for (TPair<int32, TMap<FGameplayTag, float>>& Update : Changes.Updated)
+		{
+			ItemDescriptions[Update.Key] = MoveTemp(Update.Value);
+		}
+
+		NewDescriptions = MakeShared<FItemDescriptionTable>();
+		NewDescriptions->Build(ItemDescriptions);
+		for (int32 ItemIndex = 0; ItemIndex < NumItems; ++ItemIndex)
+		{
+			NewDescriptions->UniqueIds.Edit()[ItemIndex] = Library.Items[ItemIndex].UniqueId;
+			if (Library.Items[ItemIndex].bRemoved)
+			{
+				NewDescriptions->RemoveItem(ItemIndex);
+			}
+		}
+		
+		// Plans were compiled against the old dictionary
+		Library.QueryPlans = MakeShared<FQueryPlanCache>();
+		for (int32 ViewIndex = 0; ViewIndex < Library.Views.Num(); ++ViewIndex)
+		{
+			const FFilterAndSortCriterion& Criterion = Library.Views[ViewIndex]->GetResult()->Criterion;
+			FilterAndSortAssetsInternal(*NewDescriptions, *Library.QueryPlans, FSortResult(), Criterion, Library.ShouldFilterAndSortInParallel(), FSortCancellation(), *NewResults[ViewIndex]);
+		}
+	}
+
+	Library.Descriptions = NewDescriptions;
+	for (int32 ViewIndex = 0; ViewIndex < Library.Views.Num(); ++ViewIndex)
+	{
+		Library.Views[ViewIndex]->Result = NewResults[ViewIndex];
+		Library.Views[ViewIndex]->RefreshBuffer();
+	}
+
+	// Requests that were cancelled run again on the new table so their criterion still lands and their OnComplete is still called
+	for (const TSharedRef<FLibraryView>& View : Library.Views)
+	{
+		if (View->InFlightCriterion.IsSet())
+		{
+			const FFilterAndSortCriterion Criterion = View->InFlightCriterion.GetValue();
+			const FSimpleDelegate OnComplete = View->InFlightOnComplete;
+			LaunchFilterAndSort(View, Criterion, OnComplete);
+		}
+	}
+
+	// Removed items left every sorted order so the buffers let go of them. Anything they still hold is released rather than parked.
+	for (const int32 ItemIndex : Changes.Removed)
+	{
+		FAwesomeAssetData& Item = Library.Items[ItemIndex];
+		if (Item.bResident)
+		{
+			Library.ResidencyCache->Revive(&Library, ItemIndex);
+			Item.bResident = false;
+		}
+		Item.LoadBatch.Reset();
+		Library.ReleasePaths(Item);
+	}
+	
+	UE_LOG(FLogAwesomeAssetManager, Verbose, TEXT("Library %s added %i, removed %i and updated %i items %s"), *Library.Name.ToString(), AddedDescriptions.Num(), Changes.Removed.Num(), Changes.Updated.Num(), bIncremental ? TEXT("in place") : TEXT("with a rebuild"))
+}
+
+void UAwesomeAssetManager::PatchSortResult(const FItemDescriptionTable& NewDescriptions, const FSortResult& Previous, const TArray<int32>& ChangedItems, const TBitArray<>& ChangedBits, const bool bParallel, FSortResult& NewResult)
+{
+	NewResult.Criterion = Previous.Criterion;
+	NewResult.Filter = Previous.Filter;
+	NewResult.QueryPlan = Previous.QueryPlan;
+	
+	TArray<int32> PassingItems;
+	PassingItems.Reserve(ChangedItems.Num());
+	for (const int32 ItemIndex : ChangedItems)
+	{
+		if (NewResult.Filter.Passes(NewDescriptions, ItemIndex) && (!NewResult.QueryPlan || NewResult.QueryPlan->Passes(NewDescriptions, ItemIndex)))
+		{
+			PassingItems.Emplace(ItemIndex);
+		}
+	}
+
+	// Both lists are in ascending order so merging them keeps FilteredAssets in ascending order
+	const TArray<int32>& OldFilteredAssets = *Previous.FilteredAssets;
+	const TSharedRef<TArray<int32>> NewFilteredAssets = MakeShared<TArray<int32>>();
+	NewFilteredAssets->Reserve(OldFilteredAssets.Num() + PassingItems.Num());
+	int32 NextPassing = 0;
+	for (const int32 ItemIndex : OldFilteredAssets)
+	{
+		for (; NextPassing < PassingItems.Num() && PassingItems[NextPassing] < ItemIndex; ++NextPassing)
+		{
+			NewFilteredAssets->Emplace(PassingItems[NextPassing]);
+		}
+		if (!ChangedBits[ItemIndex])
+		{
+			NewFilteredAssets->Emplace(ItemIndex);
+		}
+	}
+	NewFilteredAssets->Append(PassingItems.GetData() + NextPassing, PassingItems.Num() - NextPassing);
+	NewResult.FilteredAssets = NewFilteredAssets;
+
+	// Same for each cached column, with the passing items that have it sorted by its values first
+	for (const TPair<int32, TSharedPtr<const TArray<int32>>>& Cached : Previous.SortedColumnCache)
+	{
+		const int32 Column = Cached.Key;
+		const auto SortedBefore = [&NewDescriptions, Column](const int32 ItemA, const int32 ItemB)
+		{
+			return NewDescriptions.IsSortedBefore(Column, ItemA, ItemB);
+		};
+
+		TArray<int32> Inserted;
+		for (const int32 ItemIndex : PassingItems)
+		{
+			if (NewDescriptions.HasColumn(ItemIndex, Column))
+			{
+				Inserted.Emplace(ItemIndex);
+			}
+		}
+		Inserted.Sort(SortedBefore);
+
+		const TArray<int32>& OldColumn = *Cached.Value;
+		const TSharedRef<TArray<int32>> NewColumn = MakeShared<TArray<int32>>();
+		NewColumn->Reserve(OldColumn.Num() + Inserted.Num());
+		int32 NextInserted = 0;
+		for (const int32 ItemIndex : OldColumn)
+		{
+			if (ChangedBits[ItemIndex])
+			{
+				continue;
+			}
+			for (; NextInserted < Inserted.Num() && SortedBefore(Inserted[NextInserted], ItemIndex); ++NextInserted)
+			{
+				NewColumn->Emplace(Inserted[NextInserted]);
+			}
+			NewColumn->Emplace(ItemIndex);
+		}
+		NewColumn->Append(Inserted.GetData() + NextInserted, Inserted.Num() - NextInserted);
+		NewResult.SortedColumnCache.Emplace(Column, NewColumn);
+	}
+
+	// Columns a lazily sorted result had not gathered yet are gathered now
+	FScratchPool::FScope Scratch;
+	SortAssetsInternal(NewDescriptions, bParallel, *Scratch, FSortCancellation(), NewResult);
+}
+
+bool UAwesomeAssetManager::AddLibrary(const TSharedRef<FItemLibrary>& NewLibrary)
+{
+	// A library's name finds its default view, so it can not take the name of a view of another library
+	const TSharedPtr<FLibraryView> Existing = GetView(NewLibrary->Name);
+	if (Existing && Existing != Existing->Library->GetDefaultView())
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to add asset library %s. The name is taken by a view of library %s."), *NewLibrary->Name.ToString(), *Existing->Library->Name.ToString())
+		return false;
+	}
+
+	NewLibrary->ResidencyCache = ResidencyCache;
+	NewLibrary->PathRegistry = PathRegistry;
+	NewLibrary->StatusDispatcher = StatusDispatcher;
+
+	if (const TSharedPtr<FItemLibrary>* Replaced = Libraries.Find(NewLibrary->Name))
+	{
+		ShutdownLibrary(**Replaced);
+	}
+	
+	Libraries.Emplace(NewLibrary->Name, NewLibrary);
+	Views.Emplace(NewLibrary->Name, NewLibrary->GetDefaultView());
+	return true;
+}
+
+void UAwesomeAssetManager::RemoveAssetLibrary(FName LibraryName)
+{
+	TSharedPtr<FItemLibrary> Library;
+	if (Libraries.RemoveAndCopyValue(LibraryName, Library))
+	{
+		ShutdownLibrary(*Library);
+	}
+}
+
+void UAwesomeAssetManager::ShutdownLibrary(FItemLibrary& Library)
+{
+	// Views of a library that is removed or replaced go with it
+	for (const TSharedRef<FLibraryView>& View : Library.Views)
+	{
+		if (Views.FindRef(View->Name) == View)
+		{
+			Views.Remove(View->Name);
+		}
+	}
+	Library.Shutdown();
+}
+
+void UAwesomeAssetManager::Deinitialize()
+{
+	for (const TPair<FName, TSharedPtr<FItemLibrary>>& Pair : Libraries)
+	{
+		ShutdownLibrary(*Pair.Value);
+	}
+	Libraries.Empty();
+	Views.Empty();
+	
+	Super::Deinitialize();
 }
 
-void UAwesomeAssetManager::UpdateBuffer(TSharedPtr<FItemLibrary> Library)
+void UAwesomeAssetManager::UpdateBuffer(TSharedPtr<FLibraryView> View)
 {
-	Library->Update();
+	View->Update();
 }
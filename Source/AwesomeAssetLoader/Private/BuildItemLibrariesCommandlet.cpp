@@ -0,0 +1,9 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BuildItemLibrariesCommandlet.h"
+#include "ItemLibraryArchive.h"
+
+int32 UBuildItemLibrariesCommandlet::Main(const FString& Params)
+{
+	return FItemLibraryArchive::BuildCookedLibraries() ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BuildItemLibrariesCommandlet.generated.h"
+
+/**
+ * Writes every library listed in UAwesomeAssetLoaderSettings to its file.
+ * Run with -run=BuildItemLibraries. Cooking does the same on its own.
+ */
+UCLASS()
+class UBuildItemLibrariesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
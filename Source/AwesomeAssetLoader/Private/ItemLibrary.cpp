@@ -1,123 +1,1066 @@
 ﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 #include "ItemLibrary.h"
+#include "AwesomeAssetManager.h"
 #include "Engine/AssetManager.h"
+#include "Algo/BinarySearch.h"
+#include "QueryPlan.h"
 
 
-void FItemLibrary::Initialize(FName LibraryName, TSet<FAssetInitializeData>&& NewAssets)
+bool FItemLibraryBuilder::AddRows(const UDataTable& DataTable)
+{
+	if (!DataTable.GetRowStruct() || !DataTable.GetRowStruct()->IsChildOf(FAwesomeAssetRow::StaticStruct()))
+	{
+		return false;
+	}
+	
+	Assets.Reserve(Assets.Num() + DataTable.GetRowMap().Num());
+	for (const TPair<FName, uint8*>& Row : DataTable.GetRowMap())
+	{
+		const FAwesomeAssetRow& AssetRow = *reinterpret_cast<const FAwesomeAssetRow*>(Row.Value);
+		FAssetInitializeData& Asset = AddItem(Row.Key);
+		Asset.SoftObjectPaths.Append(AssetRow.SoftObjectPaths);
+		Asset.AssetDescriptions = AssetRow.AssetDescriptions;
+	}
+	return true;
+}
+
+void FItemDescriptionTable::Build(TConstArrayView<TMap<FGameplayTag, float>> ItemDescriptions)
+{
+	NumItems = ItemDescriptions.Num();
+	UniqueIds.Edit().SetNum(NumItems);
+
+	// Gather the description tags first so they own the lowest bits and double as column indices
+	TMap<FGameplayTag, int32>& Dictionary = TagToBit.Edit();
+	TArray<FGameplayTag>& DescriptionTags = Tags.Edit();
+	for (const TMap<FGameplayTag, float>& Description : ItemDescriptions)
+	{
+		for (const auto& Pair : Description)
+		{
+			if (!Dictionary.Contains(Pair.Key))
+			{
+				Dictionary.Emplace(Pair.Key, DescriptionTags.Emplace(Pair.Key));
+			}
+		}
+	}
+
+	// Then their parents, remembering every bit each description tag implies
+	NumBits = Tags.Num();
+	TArray<TArray<int32>> ColumnBits;
+	ColumnBits.SetNum(Tags.Num());
+	for (int32 Column = 0; Column < Tags.Num(); ++Column)
+	{
+		for (const FGameplayTag& Tag : Tags[Column].GetGameplayTagParents())
+		{
+			const int32* ExistingBit = Dictionary.Find(Tag);
+			ColumnBits[Column].Emplace(ExistingBit ? *ExistingBit : Dictionary.Emplace(Tag, NumBits++));
+		}
+	}
+
+	MaskWords = FMath::Max(1, FMath::DivideAndRoundUp(NumBits, 64));
+	TArray<uint64>& Masks = TagMasks.Edit();
+	Masks.SetNumZeroed(NumItems * MaskWords);
+	Columns.SetNum(Tags.Num());
+	for (TTableArray<float>& Column : Columns)
+	{
+		Column.Edit().SetNumZeroed(NumItems);
+	}
+
+	// Fill the columns and masks
+	for (int32 ItemIndex = 0; ItemIndex < NumItems; ++ItemIndex)
+	{
+		uint64* Mask = Masks.GetData() + ItemIndex * MaskWords;
+		for (const auto& Pair : ItemDescriptions[ItemIndex])
+		{
+			const int32 Column = Dictionary.FindChecked(Pair.Key);
+			Columns[Column].Edit()[ItemIndex] = Pair.Value;
+			for (const int32 Bit : ColumnBits[Column])
+			{
+				Mask[Bit >> 6] |= 1ull << (Bit & 63);
+			}
+		}
+	}
+
+	// Pre-sort every column once. Items are visited in order so ties stay in item order.
+	SortedColumns.SetNum(Tags.Num());
+	for (int32 Column = 0; Column < Tags.Num(); ++Column)
+	{
+		TArray<FColumnEntry>& Entries = SortedColumns[Column].Edit();
+		for (int32 ItemIndex = 0; ItemIndex < NumItems; ++ItemIndex)
+		{
+			if (HasColumn(ItemIndex, Column))
+			{
+				Entries.Emplace(FColumnEntry{ Columns[Column][ItemIndex], ItemIndex });
+			}
+		}
+		RadixSortByValue(Entries);
+	}
+}
+
+void FItemDescriptionTable::RadixSortByValue(TArray<FColumnEntry>& Entries)
 {
+	const int32 Num = Entries.Num();
+	if (Num < 2)
+	{
+		return;
+	}
+
+	// Map each float to an unsigned key with the same order
+	TArray<uint32> Keys;
+	Keys.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; ++i)
+	{
+		Keys[i] = GetSortKey(Entries[i].Value);
+	}
+
+	TArray<FColumnEntry> ScratchEntries;
+	ScratchEntries.SetNumUninitialized(Num);
+	TArray<uint32> ScratchKeys;
+	ScratchKeys.SetNumUninitialized(Num);
+
+	// One pass per byte, skipping bytes that are the same for every key
+	for (int32 Shift = 0; Shift < 32; Shift += 8)
+	{
+		int32 Counts[256] = {};
+		for (const uint32 Key : Keys)
+		{
+			++Counts[(Key >> Shift) & 0xFF];
+		}
+		if (Counts[(Keys[0] >> Shift) & 0xFF] == Num)
+		{
+			continue;
+		}
+
+		int32 Offset = 0;
+		for (int32& Count : Counts)
+		{
+			const int32 BucketSize = Count;
+			Count = Offset;
+			Offset += BucketSize;
+		}
+
+		for (int32 i = 0; i < Num; ++i)
+		{
+			const int32 Destination = Counts[(Keys[i] >> Shift) & 0xFF]++;
+			ScratchEntries[Destination] = Entries[i];
+			ScratchKeys[Destination] = Keys[i];
+		}
+		Swap(Entries, ScratchEntries);
+		Swap(Keys, ScratchKeys);
+	}
+}
+
+bool FItemDescriptionTable::HasColumns(const TMap<FGameplayTag, float>& Description) const
+{
+	for (const auto& Pair : Description)
+	{
+		if (FindColumn(Pair.Key) == INDEX_NONE)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FItemDescriptionTable::AddItems(const int32 NumNewItems)
+{
+	NumItems += NumNewItems;
+	UniqueIds.Edit().AddDefaulted(NumNewItems);
+	TagMasks.Edit().AddZeroed(NumNewItems * MaskWords);
+	for (TTableArray<float>& Column : Columns)
+	{
+		Column.Edit().AddZeroed(NumNewItems);
+	}
+	if (RemovedItems->Num() > 0)
+	{
+		RemovedItems.Edit().Add(false, NumNewItems);
+	}
+}
+
+void FItemDescriptionTable::SetDescription(const int32 ItemIndex, const TMap<FGameplayTag, float>& Description)
+{
+	// Work out the new mask from the bits of the tags and their parents before touching anything
+	TArray<uint64, TInlineAllocator<4>> NewMask;
+	NewMask.SetNumZeroed(MaskWords);
+	for (const auto& Pair : Description)
+	{
+		check(FindColumn(Pair.Key) != INDEX_NONE);
+		for (const FGameplayTag& Tag : Pair.Key.GetGameplayTagParents())
+		{
+			const int32 Bit = FindBit(Tag);
+			NewMask[Bit >> 6] |= 1ull << (Bit & 63);
+		}
+	}
+
+	for (int32 Column = 0; Column < Tags.Num(); ++Column)
+	{
+		const bool bHad = HasColumn(ItemIndex, Column);
+		const bool bHas = (NewMask[Column >> 6] >> (Column & 63)) & 1;
+		const float* Found = Description.Find(Tags[Column]);
+		const float Value = Found ? *Found : 0.f;
+		const bool bSameValue = FMemory::Memcmp(&Columns[Column][ItemIndex], &Value, sizeof(float)) == 0;
+		if (bHad == bHas && bSameValue)
+		{
+			continue;
+		}
+
+		// Take the item out of the sorted column, by value so only that part of it is searched
+		if (bHad)
+		{
+			TArray<FColumnEntry>& Entries = SortedColumns[Column].Edit();
+			const int32 Position = Algo::LowerBound(Entries, ItemIndex, [this, Column](const FColumnEntry& Entry, const int32 Item)
+			{
+				return IsSortedBefore(Column, Entry.ItemIndex, Item);
+			});
+			check(Entries.IsValidIndex(Position) && Entries[Position].ItemIndex == ItemIndex);
+			Entries.RemoveAt(Position);
+		}
+		if (!bSameValue)
+		{
+			Columns[Column].Edit()[ItemIndex] = Value;
+		}
+
+		// Then put it back in at its new place
+		if (bHas)
+		{
+			TArray<FColumnEntry>& Entries = SortedColumns[Column].Edit();
+			const int32 Position = Algo::LowerBound(Entries, ItemIndex, [this, Column](const FColumnEntry& Entry, const int32 Item)
+			{
+				return IsSortedBefore(Column, Entry.ItemIndex, Item);
+			});
+			Entries.Insert(FColumnEntry{ Value, ItemIndex }, Position);
+		}
+	}
+
+	const SIZE_T MaskSize = MaskWords * sizeof(uint64);
+	if (FMemory::Memcmp(GetMask(ItemIndex), NewMask.GetData(), MaskSize) != 0)
+	{
+		FMemory::Memcpy(TagMasks.Edit().GetData() + static_cast<SIZE_T>(ItemIndex) * MaskWords, NewMask.GetData(), MaskSize);
+	}
+}
+
+void FItemDescriptionTable::RemoveItem(const int32 ItemIndex)
+{
+	SetDescription(ItemIndex, TMap<FGameplayTag, float>());
+	if (!IsRemoved(ItemIndex))
+	{
+		TBitArray<>& Removed = RemovedItems.Edit();
+		if (Removed.Num() < NumItems)
+		{
+			Removed.Add(false, NumItems - Removed.Num());
+		}
+		Removed[ItemIndex] = true;
+		++NumRemoved;
+	}
+}
+
+void FItemDescriptionTable::GetDescription(const int32 ItemIndex, TMap<FGameplayTag, float>& OutDescription) const
+{
+	OutDescription.Reset();
+	for (int32 Column = 0; Column < Tags.Num(); ++Column)
+	{
+		if (HasColumn(ItemIndex, Column))
+		{
+			OutDescription.Emplace(Tags[Column], Columns[Column][ItemIndex]);
+		}
+	}
+}
+
+void FLazySortState::Begin(const TSharedRef<const FItemDescriptionTable>& Descriptions, const TArray<int32>& SortColumns, const bool bDescending, const int32 NumWanted, FSortResult& Result)
+{
+	const TSharedRef<FLazySortState> State = MakeShared<FLazySortState>();
+	State->Descriptions = Descriptions;
+	State->SortColumns = SortColumns;
+	State->bDescending = bDescending;
+
+	// Items without any of the sort tags are left out of the order
+	State->InOrder.Init(false, Descriptions->NumItems);
+	Result.NumSorted = 0;
+	for (const int32 ItemIndex : *Result.FilteredAssets)
+	{
+		for (const int32 Column : SortColumns)
+		{
+			if (Column != INDEX_NONE && Descriptions->HasColumn(ItemIndex, Column))
+			{
+				State->InOrder[ItemIndex] = true;
+				++Result.NumSorted;
+				break;
+			}
+		}
+	}
+
+	Result.SortedAssets.Reset();
+	Result.SortedPositions.Init(INDEX_NONE, Descriptions->NumItems);
+	Result.LazyBucket = 0;
+	Result.LazyWalked = 0;
+	Result.LazyState = State;
+	State->Extend(Result, NumWanted);
+}
+
+void FLazySortState::Extend(FSortResult& Result, const int32 NumWanted) const
+{
+	// Same walk as composing the full order, except over the pre-sorted columns of the table and only as far as needed
+	TArray<int32>& SortedAssets = Result.SortedAssets;
+	const int32 NumLaidOut = FMath::Min(NumWanted, Result.NumSorted);
+	SortedAssets.Reserve(NumLaidOut);
+	while (SortedAssets.Num() < NumLaidOut && Result.LazyBucket < SortColumns.Num())
+	{
+		const int32 Bucket = Result.LazyBucket;
+		if (SortColumns[Bucket] == INDEX_NONE)
+		{
+			++Result.LazyBucket;
+			continue;
+		}
+
+		const TTableArray<FColumnEntry>& Entries = Descriptions->SortedColumns[SortColumns[Bucket]];
+		for (; Result.LazyWalked < Entries.Num() && SortedAssets.Num() < NumLaidOut; ++Result.LazyWalked)
+		{
+			const int32 ItemIndex = Entries[bDescending ? Entries.Num() - 1 - Result.LazyWalked : Result.LazyWalked].ItemIndex;
+			if (!InOrder[ItemIndex])
+			{
+				continue;
+			}
+			
+			// Each item goes in the bucket of the first sort tag it has
+			bool bBelongsInBucket = true;
+			for (int32 Earlier = 0; Earlier < Bucket && bBelongsInBucket; ++Earlier)
+			{
+				bBelongsInBucket = SortColumns[Earlier] == INDEX_NONE || !Descriptions->HasColumn(ItemIndex, SortColumns[Earlier]);
+			}
+			if (bBelongsInBucket)
+			{
+				Result.SortedPositions[ItemIndex] = SortedAssets.Num();
+				SortedAssets.Emplace(ItemIndex);
+			}
+		}
+
+		if (Result.LazyWalked == Entries.Num())
+		{
+			++Result.LazyBucket;
+			Result.LazyWalked = 0;
+		}
+	}
+
+	if (SortedAssets.Num() == Result.NumSorted)
+	{
+		Result.LazyState.Reset();
+	}
+}
+
+template <typename AssetContainerType>
+void FItemLibrary::InitializeFrom(FName LibraryName, AssetContainerType& NewAssets, const TSharedPtr<const FItemDescriptionTable>& PrebuiltDescriptions)
+{
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
 	Name = LibraryName;
 	Items.Reserve(NewAssets.Num());
 
+	// Every item's paths go into one array
+	int32 NumPaths = 0;
+	for (const auto& Asset : NewAssets)
+	{
+		NumPaths += Asset.SoftObjectPaths.Num();
+	}
+	ItemPaths.Reserve(NumPaths);
+
+	// Descriptions are moved into the table so keep them aside until it is built
+	TArray<TMap<FGameplayTag, float>> ItemDescriptions;
+	ItemDescriptions.Reserve(PrebuiltDescriptions ? 0 : NewAssets.Num());
+
+	UniqueIdToItem.Reserve(NewAssets.Num());
 	for (auto& Asset : NewAssets)
 	{
-		Items.Emplace(MakeShared<FAwesomeAssetData>(MoveTemp(Asset)));
+		if (!Asset.UniqueId.IsNone())
+		{
+			if (UniqueIdToItem.Contains(Asset.UniqueId))
+			{
+				UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library %s has more than one asset with the unique Id %s. Only the first can be found by Id."), *Name.ToString(), *Asset.UniqueId.ToString());
+			}
+			else
+			{
+				UniqueIdToItem.Emplace(Asset.UniqueId, Items.Num());
+			}
+		}
+		
+		if (!PrebuiltDescriptions)
+		{
+			ItemDescriptions.Emplace(MoveTemp(Asset.AssetDescriptions));
+		}
+		Items.Emplace(MoveTemp(Asset), ItemPaths);
+	}
+
+	if (PrebuiltDescriptions)
+	{
+		check(PrebuiltDescriptions->NumItems == Items.Num());
+		Descriptions = PrebuiltDescriptions;
+	}
+	else
+	{
+		const TSharedRef<FItemDescriptionTable> NewDescriptions = MakeShared<FItemDescriptionTable>();
+		NewDescriptions->Build(ItemDescriptions);
+		for (int32 ItemIndex = 0; ItemIndex < Items.Num(); ++ItemIndex)
+		{
+			NewDescriptions->UniqueIds.Edit()[ItemIndex] = Items[ItemIndex].UniqueId;
+		}
+		Descriptions = NewDescriptions;
 	}
+
+	QueryPlans = MakeShared<FQueryPlanCache>();
+	Views.Emplace(MakeShared<FLibraryView>(*this, LibraryName));
+	
+	PendingLoads.SetNum(FBufferWindow::FirstBufferBand + MaxPriorityGrades);
 }
 
-void FItemLibrary::Update()
+TSharedRef<FSortResult> FItemLibrary::MakeInitialResult() const
 {
-	UAssetManager* AssetManager = UAssetManager::GetIfInitialized();
-	check(AssetManager);
+	// Nothing is filtered out until a filter is set, which matches an empty filter
+	const TSharedRef<TArray<int32>> AllItems = MakeShared<TArray<int32>>();
+	AllItems->Reserve(Items.Num() - Descriptions->NumRemoved);
+	for (int32 ItemIndex = 0; ItemIndex < Items.Num(); ++ItemIndex)
+	{
+		if (!Descriptions->IsRemoved(ItemIndex))
+		{
+			AllItems->Emplace(ItemIndex);
+		}
+	}
+
+	const TSharedRef<FSortResult> InitialResult = MakeShared<FSortResult>();
+	InitialResult->Filter = FTagMaskFilter::Compile(*Descriptions, FGameplayTagContainer(), FGameplayTagContainer());
+	InitialResult->FilteredAssets = AllItems;
+	InitialResult->SortedPositions.Init(INDEX_NONE, Items.Num());
+	return InitialResult;
+}
+
+FLibraryView::FLibraryView(FItemLibrary& InLibrary, FName InName)
+	: Library(&InLibrary)
+	, Name(InName)
+	, Result(InLibrary.MakeInitialResult())
+{
+	ItemBands.SetNumZeroed(InLibrary.Items.Num());
+}
+
+FLibraryView::~FLibraryView()
+{
+	delete PendingResult.exchange(nullptr);
+	if (DebounceTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(DebounceTickerHandle);
+	}
+}
+
+TSharedRef<FLibraryView> FItemLibrary::AddView(FName ViewName)
+{
+	return Views.Emplace_GetRef(MakeShared<FLibraryView>(*this, ViewName));
+}
+
+void FItemLibrary::RemoveView(const TSharedRef<FLibraryView>& View)
+{
+	check(View != GetDefaultView());
+	View->Detach();
+	Views.Remove(View);
+}
+
+uint8 FItemLibrary::GetNearestBand(const int32 ItemIndex) const
+{
+	uint8 Nearest = FBufferWindow::NoBand;
+	for (const TSharedRef<FLibraryView>& View : Views)
+	{
+		const uint8 Band = View->ItemBands[ItemIndex];
+		if (Band != FBufferWindow::NoBand && (Nearest == FBufferWindow::NoBand || Band < Nearest))
+		{
+			Nearest = Band;
+		}
+	}
+	return Nearest;
+}
+
+void FItemLibrary::Initialize(FName LibraryName, TSet<FAssetInitializeData>&& NewAssets)
+{
+	InitializeFrom(LibraryName, NewAssets, nullptr);
+}
+
+void FItemLibrary::Initialize(FName LibraryName, TArray<FAssetInitializeData>&& NewAssets)
+{
+	InitializeFrom(LibraryName, NewAssets, nullptr);
+}
+
+void FItemLibrary::Initialize(FName LibraryName, TArray<FAssetInitializeData>&& NewAssets, const TSharedRef<const FItemDescriptionTable>& PrebuiltDescriptions)
+{
+	InitializeFrom(LibraryName, NewAssets, PrebuiltDescriptions);
+}
+
+FItemLibrary::~FItemLibrary()
+{
+	// The manager shuts libraries down as it lets go of them, so only one that was never added can get here still connected
+	if (PathRegistry)
+	{
+		check(IsInGameThread());
+		Shutdown();
+	}
+}
+
+void FItemLibrary::Shutdown()
+{
+	check(IsInGameThread());
+	for (const TSharedRef<FLibraryView>& View : Views)
+	{
+		View->Detach();
+	}
+	if (IssueTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(IssueTickerHandle);
+		IssueTickerHandle.Reset();
+	}
+	if (ResidencyCache)
+	{
+		ResidencyCache->RemoveLibrary(this);
+	}
+	if (StatusDispatcher)
+	{
+		StatusDispatcher->RemoveLibrary(this);
+	}
+	for (TArray<int32>& Pending : PendingLoads)
+	{
+		Pending.Reset();
+	}
+	for (FAwesomeAssetData& Item : Items)
+	{
+		Item.LoadBatch.Reset();
+		Item.bResident = false;
+		Item.bStatusQueued = false;
+		ReleasePaths(Item);
+	}
 	
+	ResidencyCache.Reset();
+	PathRegistry.Reset();
+	StatusDispatcher.Reset();
+}
+
+const TSharedRef<const FSortResult>& FLibraryView::GetResult()
+{
+	check(IsInGameThread());
+	if (FSortResult* Pending = PendingResult.exchange(nullptr))
+	{
+		// A lazy sort publishes twice under the same generation, the complete result after the one with only its start laid out
+		if (Pending->Generation > Result->Generation || (Pending->Generation == Result->Generation && !Result->IsComplete()))
+		{
+			Result = MakeShareable(Pending);
+		}
+		else
+		{
+			delete Pending;
+		}
+	}
+	return Result;
+}
+
+void FLibraryView::PublishResult(TUniquePtr<FSortResult> NewResult)
+{
+	// Swap the result in. If that displaced a newer result, swap the newer one back in and drop whichever is older.
+	FSortResult* Candidate = NewResult.Release();
+	while (Candidate)
+	{
+		FSortResult* Displaced = PendingResult.exchange(Candidate);
+		if (Displaced && Displaced->Generation > Candidate->Generation)
+		{
+			Candidate = Displaced;
+		}
+		else
+		{
+			delete Displaced;
+			Candidate = nullptr;
+		}
+	}
+}
+
+void FLibraryView::RefreshBuffer()
+{
+	if (bHasBufferTarget && GetResult() != BufferResult)
+	{
+		Update();
+	}
+}
+
+TSharedRef<const FSortResult> FLibraryView::EnsureSorted(const TSharedRef<const FSortResult> Current, const int32 NumWanted)
+{
+	check(IsInGameThread());
+	if (Current->IsComplete() || Current->SortedAssets.Num() >= NumWanted)
+	{
+		return Current;
+	}
+
+	// Results are shared so the order is extended in a copy. Laying out at least twice as much each time keeps the copies amortized.
+	const TSharedRef<FSortResult> Extended = MakeShared<FSortResult>(*Current);
+	Current->LazyState->Extend(*Extended, FMath::Max(NumWanted, 2 * Current->SortedAssets.Num()));
+
+	// The copy only takes over if nothing newer was adopted since the caller took its snapshot
+	if (Result == Current)
+	{
+		Result = Extended;
+	}
+	return Extended;
+}
+
+int32 FLibraryView::FindSortedPosition(const int32 ItemIndex)
+{
+	TSharedRef<const FSortResult> Current = GetResult();
+	if (Current->SortedPositions[ItemIndex] == INDEX_NONE && !Current->IsComplete() && Current->LazyState->InOrder[ItemIndex])
+	{
+		// The item is in the order but not laid out yet
+		Current = EnsureSorted(Current, Current->NumSorted);
+	}
+	return Current->SortedPositions[ItemIndex];
+}
+
+void FLibraryView::Update()
+{
+	// Use the latest finished result rather than waiting on a sort that is still running, and only that one for the whole update.
+	// If only the start of its order is laid out so far, the rest of the window is laid out here.
+	const TSharedRef<const FSortResult> Current = GetResult();
+	const FBufferWindow NewWindow = bHasBufferTarget ? MakeBufferWindow(Current->NumSorted) : FBufferWindow();
+	const TSharedRef<const FSortResult> NewResult = EnsureSorted(Current, NewWindow.BufferEnd + 1);
+	const TArray<int32>& SortedAssets = NewResult->SortedAssets;
+
+	// Only items whose band changes are touched. Lists are indexed by band, the first being the items to unload.
+	FItemLibrary::FBandChanges ToChange;
+	ToChange.SetNum(FBufferWindow::FirstBufferBand + NewWindow.NumGrades);
+	const auto ChangeBand = [this, &ToChange](const int32 ItemIndex, const uint8 Band)
+	{
+		if (ItemBands[ItemIndex] != Band)
+		{
+			ToChange[Band].Emplace(ItemIndex);
+		}
+	};
+
+	// Results of one generation share their order, even when more of it is laid out in one of them
+	if (BufferResult && BufferResult->Generation == NewResult->Generation)
+	{
+		// Same order, so the window edges split the positions into segments where neither the old nor the new band changes.
+		// Only segments whose band differs are walked, making a scroll cost proportional to its distance.
+		TArray<int32, TInlineAllocator<40>> Edges;
+		BufferWindow.AddEdges(Edges);
+		NewWindow.AddEdges(Edges);
+		Edges.Sort();
+		
+		for (int32 Edge = 0; Edge + 1 < Edges.Num(); ++Edge)
+		{
+			const int32 SegmentStart = Edges[Edge];
+			const int32 SegmentEnd = Edges[Edge + 1];
+			const uint8 NewBand = NewWindow.GetBand(SegmentStart);
+			if (SegmentStart < SegmentEnd && BufferWindow.GetBand(SegmentStart) != NewBand)
+			{
+				for (int32 Position = SegmentStart; Position < SegmentEnd; ++Position)
+				{
+					ChangeBand(SortedAssets[Position], NewBand);
+				}
+			}
+		}
+	}
+	else
+	{
+		// The order changed so positions can not be compared. Release what left the window, then walk the new window.
+		if (BufferResult)
+		{
+			for (int32 Position = FMath::Max(BufferWindow.BufferStart, 0); Position <= BufferWindow.BufferEnd; ++Position)
+			{
+				const int32 ItemIndex = BufferResult->SortedAssets[Position];
+				const int32 NewPosition = NewResult->SortedPositions[ItemIndex];
+				if (NewPosition == INDEX_NONE || NewWindow.GetBand(NewPosition) == FBufferWindow::NoBand)
+				{
+					ChangeBand(ItemIndex, FBufferWindow::NoBand);
+				}
+			}
+		}
+		
+		for (int32 Position = NewWindow.BufferStart; Position <= NewWindow.BufferEnd; ++Position)
+		{
+			ChangeBand(SortedAssets[Position], NewWindow.GetBand(Position));
+		}
+	}
+
+	BufferResult = NewResult;
+	BufferWindow = NewWindow;
+
+	Library->ChangeBands(*this, ToChange);
+}
+
+void FLibraryView::ReleaseBuffer()
+{
+	bHasBufferTarget = false;
+	Update();
+}
+
+void FLibraryView::Detach()
+{
+	check(IsInGameThread());
+	if (!Library)
+	{
+		return;
+	}
+
+	// Tasks still running for the view are dropped and a request waiting out its debounce window never starts
+	++TaskCounter;
+	if (DebounceTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(DebounceTickerHandle);
+		DebounceTickerHandle.Reset();
+	}
+	DebouncedOnComplete.Unbind();
+	InFlightCriterion.Reset();
+	InFlightOnComplete.Unbind();
+	
+	ReleaseBuffer();
+	Library = nullptr;
+}
+
+void FItemLibrary::ChangeBands(FLibraryView& View, const FBandChanges& ToChange)
+{
+	// Requests are only queued here and issued in batches below
 	const auto SetupOrChangeLoad =
-		[](const TSet<TSharedPtr<FAwesomeAssetData>>& Assets, const TAsyncLoadPriority Priority)
+		[this](const TArray<int32>& Assets, const uint8 Band)
 		{
-			const UAssetManager* AssetManager = UAssetManager::GetIfInitialized();
-			check(AssetManager);
-			
-			for (const auto& AwesomeAssetData : Assets)
+			const TAsyncLoadPriority Priority = GetBandPriority(Band);
+			for (const int32 ItemIndex : Assets)
 			{
-				// Skip this asset if it is already loading correctly or stop loading to change priority
-				if (AwesomeAssetData->LoadHandle.IsValid())
+				FAwesomeAssetData* AwesomeAssetData = &Items[ItemIndex];
+				AwesomeAssetData->LoadBand = Band;
+
+				// Parked handles are still loaded so they come back without a new load
+				if (AwesomeAssetData->bResident)
+				{
+					ResidencyCache->Revive(this, ItemIndex);
+					AwesomeAssetData->bResident = false;
+					NotifyStatus(ItemIndex, true);
+					continue;
+				}
+
+				// Skip this asset if it is already loading well enough or leave its batch to be promoted
+				if (AwesomeAssetData->LoadBatch.IsValid())
 				{
-					// Keep handle because it is either loading with the right priority or it is loaded
-					if (AwesomeAssetData->LoadHandle->HasLoadCompleted() || AwesomeAssetData->LoadHandle->GetPriority() == Priority)
+					// Keep the batch if it is loaded or loading at the same or a higher priority.
+					// A load can not be demoted in place and restarting it would throw away the work done.
+					if (AwesomeAssetData->LoadBatch->Priority >= Priority || PathRegistry->AreLoaded(GetPaths(*AwesomeAssetData)))
 					{
 						continue;
 					}
-					AwesomeAssetData->LoadHandle->ReleaseHandle();
+					
+					// Promote by requesting again at the higher priority, which raises the load already in flight.
+					// Its paths stay held, so the old request keeps loading until the new one takes over.
+					AwesomeAssetData->LoadBatch.Reset();
 				}
 
-				// On load delegate
-				FStreamableDelegate OnLoad = FStreamableDelegate::CreateLambda([AwesomeAssetData]()
-					{
-						if (AwesomeAssetData.IsValid())
-						{
-							AwesomeAssetData->OnStatusChange.ExecuteIfBound(true);
-						}
-					});
-
-				// Perform actual load
-				AwesomeAssetData->LoadHandle = AssetManager->GetStreamableManager().RequestAsyncLoad(AwesomeAssetData->AssetsToLoad.Array(), OnLoad);
+				PendingLoads[Band].Emplace(ItemIndex);
 			}
 		};
 
-	// Get requested assets
-	TSet<TSharedPtr<FAwesomeAssetData>> HighPriority;
-	TSet<TSharedPtr<FAwesomeAssetData>> DefaultPriority;
-	GetRequestedAssets(HighPriority, DefaultPriority);
-
-	// Load or change requested assets
-	SetupOrChangeLoad(HighPriority, FStreamableManager::AsyncLoadHighPriority);
-	SetupOrChangeLoad(DefaultPriority, FStreamableManager::DefaultAsyncLoadPriority);
+	// Items load at the nearest band any view has for them, so an item shown by several views is only loaded once
+	FBandChanges NearestChanges;
+	NearestChanges.SetNum(FBufferWindow::FirstBufferBand + MaxPriorityGrades);
+	for (int32 Band = 0; Band < ToChange.Num(); ++Band)
+	{
+		for (const int32 ItemIndex : ToChange[Band])
+		{
+			View.ItemBands[ItemIndex] = static_cast<uint8>(Band);
+			const uint8 Nearest = Views.Num() == 1 ? static_cast<uint8>(Band) : GetNearestBand(ItemIndex);
+			if (Items[ItemIndex].LoadBand != Nearest)
+			{
+				NearestChanges[Nearest].Emplace(ItemIndex);
+			}
+		}
+	}
 
-	
-	TSet<TSharedPtr<FAwesomeAssetData>> NewAssetRequest;
-	NewAssetRequest.Append(MoveTemp(HighPriority));
-	NewAssetRequest.Append(MoveTemp(DefaultPriority));
-	
+	// Queue requested assets or change their priority, nearest band first
+	for (int32 Band = FBufferWindow::TargetBand; Band < NearestChanges.Num(); ++Band)
+	{
+		SetupOrChangeLoad(NearestChanges[Band], Band);
+	}
 
 	// Unload items out of range
-	const TSet<TSharedPtr<FAwesomeAssetData>> ToUnload = RequestedAssets.Difference(NewAssetRequest);
-	for (const auto& AssetToUnload : ToUnload)
+	for (const int32 ItemIndex : NearestChanges[FBufferWindow::NoBand])
 	{
-		AssetToUnload->LoadHandle.Reset();
-		AssetToUnload->OnStatusChange.ExecuteIfBound(false);
+		FAwesomeAssetData& AssetToUnload = Items[ItemIndex];
+		AssetToUnload.LoadBand = FBufferWindow::NoBand;
+		ParkOrRelease(AssetToUnload, ItemIndex);
+		NotifyStatus(ItemIndex, false);
+	}
+
+	// Issue what fits in this frame and keep ticking for the rest
+	if (IssuePendingLoads() && !IssueTickerHandle.IsValid())
+	{
+		const TWeakPtr<FItemLibrary> WeakThis = AsShared();
+		IssueTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis](float)
+		{
+			const TSharedPtr<FItemLibrary> Library = WeakThis.Pin();
+			if (Library && Library->IssuePendingLoads())
+			{
+				return true;
+			}
+			if (Library)
+			{
+				Library->IssueTickerHandle.Reset();
+			}
+			return false;
+		}));
 	}
-	
-	RequestedAssets = MoveTemp(NewAssetRequest);
 }
 
-void FItemLibrary::GetRequestedAssets(TSet<TSharedPtr<FAwesomeAssetData>>& HighPriority, TSet<TSharedPtr<FAwesomeAssetData>>& DefaultPriority)
+bool FItemLibrary::IssuePendingLoads()
 {
-	// Block if there is still a sorting task happening. Right now we need to access the SortedAssets
-	verify(SortAndFilterTask.Wait());
-	FScopeLock ScopeLock(&Lock);
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+	UAssetManager* AssetManager = UAssetManager::GetIfInitialized();
+	check(AssetManager);
 	
-	//todo add range validation so there is no need for an IsValidIndex() check.
+	const TWeakPtr<FItemLibrary> WeakThis = AsShared();
+	const double EndTime = FPlatformTime::Seconds() + IssueBudgetSeconds;
+	bool bProcessedAny = false;
+	
+	for (int32 Band = FBufferWindow::TargetBand; Band < PendingLoads.Num(); ++Band)
+	{
+		TArray<int32>& Pending = PendingLoads[Band];
+		int32 NumTaken = 0;
+		while (NumTaken < Pending.Num())
+		{
+			// Batches that only notify, or only wait on requests already running, count against the budget as well
+			if (bProcessedAny && FPlatformTime::Seconds() > EndTime)
+			{
+				Pending.RemoveAt(0, NumTaken);
+				return true;
+			}
+			
+			// Gather the next batch, skipping items that moved band or got a load since being queued
+			const TSharedRef<FLoadBatch> Batch = MakeShared<FLoadBatch>();
+			Batch->Priority = GetBandPriority(Band);
+			FPathRegistry::FRequestPaths ToRequest;
+			TArray<int32, TInlineAllocator<MaxBatchSize>> Ready;
+			int32 NumGathered = 0;
+			while (NumTaken < Pending.Num() && NumGathered < MaxBatchSize)
+			{
+				const int32 ItemIndex = Pending[NumTaken++];
+				FAwesomeAssetData& Item = Items[ItemIndex];
+				if (Item.LoadBand != Band || Item.bResident || Item.LoadBatch.IsValid())
+				{
+					continue;
+				}
+				
+				// Only paths nothing is loading yet are requested, shared with every other item and library.
+				// Paths a request is already loading well enough are waited on rather than requested again.
+				if (!Item.bPathsHeld)
+				{
+					PathRegistry->Acquire(GetPaths(Item), Batch->Priority, ToRequest, Batch->WaitingOn);
+					Item.bPathsHeld = true;
+				}
+				else
+				{
+					// Promoted, so what is still loading below this priority is requested again at it
+					PathRegistry->Gather(GetPaths(Item), Batch->Priority, ToRequest, Batch->WaitingOn);
+				}
+				
+				Item.LoadBatch = Batch;
+				++NumGathered;
+				if (PathRegistry->AreLoaded(GetPaths(Item)))
+				{
+					Ready.Emplace(ItemIndex);
+				}
+				else
+				{
+					Batch->Members.Emplace(ItemIndex);
+				}
+			}
+			bProcessedAny = true;
+			
+			// Items whose paths were all loaded already are ready without a request
+			for (const int32 ItemIndex : Ready)
+			{
+				NotifyStatus(ItemIndex, true);
+			}
+			if (Batch->Members.IsEmpty())
+			{
+				continue;
+			}
+			
+			// Perform actual load, of only the paths no request is loading yet
+			if (!ToRequest.IsEmpty())
+			{
+				Batch->Request = PathRegistry->Request(ToRequest.Array(), Batch->Priority, AssetManager->GetStreamableManager());
+			}
+
+			// Members are notified as each request they wait on completes, once all of their paths are in
+			const auto OnLoad = [WeakThis, WeakBatch = TWeakPtr<FLoadBatch>(Batch)]()
+			{
+				const TSharedPtr<FItemLibrary> Library = WeakThis.Pin();
+				const TSharedPtr<FLoadBatch> LoadedBatch = WeakBatch.Pin();
+				if (Library && LoadedBatch)
+				{
+					Library->NotifyLoadedMembers(*LoadedBatch);
+				}
+			};
+			if (Batch->Request)
+			{
+				Batch->Request->OnCompleted.AddLambda(OnLoad);
+			}
+			for (const TSharedRef<FPathRegistry::FPathRequest>& Request : Batch->WaitingOn)
+			{
+				Request->OnCompleted.AddLambda(OnLoad);
+			}
+
+			// Requests with nothing valid to load, or that finished already, will not broadcast again
+			NotifyLoadedMembers(*Batch);
+		}
+		Pending.Reset();
+	}
 	
-	// Fill high priority
-	const int32 NumItemsInBufferTargetRange = FMath::Clamp(TargetEnd - TargetStart, 0, MAX_int32); 
-	HighPriority.Empty(NumItemsInBufferTargetRange);
+	return false;
+}
+
+TAsyncLoadPriority FItemLibrary::GetBandPriority(const uint8 Band)
+{
+	// Each buffer grade further out loads one priority step lower
+	return Band == FBufferWindow::TargetBand
+		? FStreamableManager::AsyncLoadHighPriority
+		: FStreamableManager::DefaultAsyncLoadPriority - (Band - FBufferWindow::FirstBufferBand);
+}
+
+void FItemLibrary::NotifyStatus(const int32 ItemIndex, const bool bLoaded)
+{
+	FAwesomeAssetData& Item = Items[ItemIndex];
 	
-	for (int i = TargetStart; i <= TargetEnd; ++i)
+	// Items already queued stay queued so their changes keep their order after the dispatcher is turned off
+	if (StatusDispatcher && (StatusDispatcher->Settings.bEnabled || Item.bStatusQueued))
 	{
-		if (SortedAssets.IsValidIndex(i))
+		Item.bQueuedStatus = bLoaded;
+		if (!Item.bStatusQueued)
 		{
-			HighPriority.Emplace(SortedAssets[i]);
+			Item.bStatusQueued = true;
+			StatusDispatcher->Enqueue(this, ItemIndex);
 		}
+		return;
 	}
 
-	// Fill buffer
-	const int32 FullRangeCount = BufferSize * 2;
-	DefaultPriority.Empty(FullRangeCount);
+	Item.bDeliveredStatus = bLoaded;
+	Item.OnStatusChange.ExecuteIfBound(bLoaded);
+}
+
+void FItemLibrary::NotifyLoadedMembers(FLoadBatch& Batch)
+{
+	// Members are taken out before any is notified, since a notification can change the batch
+	TArray<int32, TInlineAllocator<MaxBatchSize>> Loaded;
+	Batch.Members.RemoveAll([this, &Batch, &Loaded](const int32 ItemIndex)
+	{
+		const FAwesomeAssetData& Item = Items[ItemIndex];
+		if (Item.LoadBatch.Get() != &Batch)
+		{
+			return true;
+		}
+		if (PathRegistry->AreLoaded(GetPaths(Item)))
+		{
+			Loaded.Emplace(ItemIndex);
+			return true;
+		}
+		return false;
+	});
 	
-	// Front buffer
-	for (int i = TargetStart - BufferSize; i < TargetStart; ++i)
+	for (const int32 ItemIndex : Loaded)
+	{
+		NotifyStatus(ItemIndex, true);
+	}
+}
+
+void FItemLibrary::ParkOrRelease(FAwesomeAssetData& Item, const int32 ItemIndex)
+{
+	Item.LoadBatch.Reset();
+	if (Item.bPathsHeld && ResidencyCache && PathRegistry->AreLoaded(GetPaths(Item)))
 	{
-		if (SortedAssets.IsValidIndex(i))
+		// Mark first since parking can evict right away
+		Item.bResident = true;
+		if (ResidencyCache->Park(this, ItemIndex, EstimateResidentSize(Item)))
 		{
-			DefaultPriority.Emplace(SortedAssets[i]);
+			return;
 		}
+		Item.bResident = false;
 	}
+	
+	ReleasePaths(Item);
+}
+
+void FItemLibrary::ReleaseResident(const int32 ItemIndex)
+{
+	FAwesomeAssetData& Item = Items[ItemIndex];
+	check(Item.bResident);
+	Item.bResident = false;
+	ReleasePaths(Item);
+}
 
-	// Back buffer
-	for (int i = TargetEnd + 1; i <= TargetEnd + BufferSize; ++i)
+void FItemLibrary::ReleasePaths(FAwesomeAssetData& Item)
+{
+	if (Item.bPathsHeld)
 	{
-		if (SortedAssets.IsValidIndex(i))
+		PathRegistry->Release(GetPaths(Item));
+		Item.bPathsHeld = false;
+	}
+}
+
+int64 FItemLibrary::EstimateResidentSize(const FAwesomeAssetData& Item) const
+{
+	// Only the item's own assets count, not those of the rest of its batch
+	int64 SizeBytes = 0;
+	for (const FSoftObjectPath& Path : GetPaths(Item))
+	{
+		if (UObject* LoadedAsset = Path.ResolveObject())
 		{
-			DefaultPriority.Emplace(SortedAssets[i]);
+			SizeBytes += LoadedAsset->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
 		}
 	}
-}
\ No newline at end of file
+	return SizeBytes;
+}
+
+void FLibraryView::SetBufferTarget(const int32 NewTargetStart, const int32 NewTargetEnd, const int32 NewBufferSize)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double DeltaTime = Now - LastTargetTime;
+	if (!bHasBufferTarget || DeltaTime > PredictiveSettings.IdleResetTime)
+	{
+		// Starting from rest
+		ScrollVelocity = 0.f;
+	}
+	else if (DeltaTime > UE_SMALL_NUMBER)
+	{
+		// Several targets in one frame only count once time has passed
+		const float Moved = ((NewTargetStart + NewTargetEnd) - (TargetStart + TargetEnd)) * 0.5f;
+		ScrollVelocity = FMath::Lerp(static_cast<float>(Moved / DeltaTime), ScrollVelocity, PredictiveSettings.VelocitySmoothing);
+	}
+	
+	if (DeltaTime > UE_SMALL_NUMBER)
+	{
+		LastTargetTime = Now;
+	}
+	
+	BufferSize = NewBufferSize;
+	TargetStart = NewTargetStart;
+	TargetEnd = NewTargetEnd;
+	bHasBufferTarget = true;
+}
+
+FBufferWindow FLibraryView::MakeBufferWindow(const int32 NumSorted) const
+{
+	FBufferWindow Window;
+	Window.FrontSize = BufferSize;
+	Window.BackSize = BufferSize;
+
+	if (PredictiveSettings.bEnabled)
+	{
+		// Move part of the buffer from behind the target to ahead of it, the faster the scroll the more moves
+		const float Skew = FMath::Clamp(ScrollVelocity / FMath::Max(PredictiveSettings.FullSkewSpeed, 1.f), -1.f, 1.f) * PredictiveSettings.MaxSkew;
+		const int32 Shift = FMath::RoundToInt(BufferSize * Skew);
+		Window.FrontSize = BufferSize - Shift;
+		Window.BackSize = BufferSize + Shift;
+		Window.NumGrades = FMath::Clamp(PredictiveSettings.NumPriorityGrades, 1, FItemLibrary::MaxPriorityGrades);
+	}
+	
+	if (NumSorted > 0)
+	{
+		Window.TargetStart = FMath::Max(TargetStart, 0);
+		Window.TargetEnd = FMath::Min(TargetEnd, NumSorted - 1);
+		Window.BufferStart = FMath::Clamp(TargetStart - Window.FrontSize, 0, Window.TargetStart);
+		Window.BufferEnd = FMath::Clamp(TargetEnd + Window.BackSize, Window.TargetEnd, NumSorted - 1);
+	}
+	return Window;
+}
@@ -7,10 +7,31 @@
 #include "UObject/Object.h"
 #include "GameplayTagContainer.h"
 #include "Engine/StreamableManager.h"
+#include "Engine/DataTable.h"
+#include "Containers/Ticker.h"
+#include "Async/MappedFileHandle.h"
+#include "TagMaskFilter.h"
+#include "ResidencyCache.h"
+#include "PathRegistry.h"
+#include "StatusDispatcher.h"
+#include "ScratchPool.h"
 #include "ItemLibrary.generated.h"
 
 DECLARE_DELEGATE_OneParam(FOnStatusChange, const bool /*ShouldLoad*/);
 
+class FQueryPlan;
+class FQueryPlanCache;
+
+/** When a library should filter and sort across several worker threads */
+UENUM(BlueprintType)
+enum class EParallelFilterAndSort : uint8
+{
+	/** Only libraries with at least FItemLibrary::ParallelFilterAndSortThreshold items */
+	Automatic,
+	Always,
+	Never
+};
+
 /** Describes the primary asset to load and the required bundles */
 USTRUCT(BlueprintType)
 struct FAssetLoadRequest
@@ -65,85 +86,842 @@ struct FAssetInitializeData
 	}
 };
 
-/** Describes each item to be tracked and have its dependencies loaded. */
+/** What a term of an FAssetQuery tests */
+UENUM(BlueprintType)
+enum class EAssetQueryTermType : uint8
+{
+	/** Every child term matches. Matches when it has no children. */
+	AllOf,
+	/** At least one child term matches */
+	AnyOf,
+	/** No child term matches */
+	NoneOf,
+	/** The item has Tag or a child of it */
+	HasTag,
+	/** The item has a description value for Tag between Min and Max, inclusive */
+	ValueInRange
+};
+
+/** One term of an FAssetQuery */
+USTRUCT(BlueprintType)
+struct FAssetQueryTerm
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	EAssetQueryTermType Type = EAssetQueryTermType::AllOf;
+
+	/** For groups, the number of terms directly under it. They follow the group in the term list. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	int32 NumChildren = 0;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	FGameplayTag Tag;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	float Min = 0.f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	float Max = 0.f;
+
+	FORCEINLINE friend uint32 GetTypeHash(const FAssetQueryTerm& Term)
+	{
+		uint32 Hash = HashCombineFast(GetTypeHash(static_cast<uint8>(Term.Type)), GetTypeHash(Term.NumChildren));
+		Hash = HashCombineFast(Hash, GetTypeHash(Term.Tag));
+		return HashCombineFast(Hash, HashCombineFast(GetTypeHash(Term.Min), GetTypeHash(Term.Max)));
+	}
+
+	bool operator==(const FAssetQueryTerm& Other) const
+	{
+		return Type == Other.Type && NumChildren == Other.NumChildren && Tag == Other.Tag && Min == Other.Min && Max == Other.Max;
+	}
+};
+
+/**
+ * Boolean expression over an item's tags and description values, for what MustHaveTags and MustNotHaveTags can not express.
+ * Terms are listed depth first, each group followed by its children. Every top level term has to match.
+ * Libraries compile each query once into an FQueryPlan and keep it by hash.
+ */
+USTRUCT(BlueprintType)
+struct FAssetQuery
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Query)
+	TArray<FAssetQueryTerm> Terms;
+
+	FORCEINLINE bool IsEmpty() const { return Terms.IsEmpty(); }
+
+	/** Adds a term that matches items with the tag or a child of it */
+	FAssetQuery& HasTag(const FGameplayTag& Tag)
+	{
+		AddTerm(EAssetQueryTermType::HasTag).Tag = Tag;
+		return *this;
+	}
+
+	/** Adds a term that matches items with a value for the tag between Min and Max, inclusive */
+	FAssetQuery& ValueInRange(const FGameplayTag& Tag, const float Min, const float Max)
+	{
+		FAssetQueryTerm& Term = AddTerm(EAssetQueryTermType::ValueInRange);
+		Term.Tag = Tag;
+		Term.Min = Min;
+		Term.Max = Max;
+		return *this;
+	}
+
+	/** Opens a group. Terms added until the matching EndGroup go in it. */
+	FAssetQuery& BeginGroup(const EAssetQueryTermType GroupType)
+	{
+		check(GroupType == EAssetQueryTermType::AllOf || GroupType == EAssetQueryTermType::AnyOf || GroupType == EAssetQueryTermType::NoneOf);
+		AddTerm(GroupType);
+		OpenGroups.Emplace(Terms.Num() - 1);
+		return *this;
+	}
+
+	/** Closes the latest open group. Calling it with no group open is ignored. */
+	FAssetQuery& EndGroup()
+	{
+		if (ensureMsgf(!OpenGroups.IsEmpty(), TEXT("EndGroup was called without a matching BeginGroup")))
+		{
+			OpenGroups.Pop(EAllowShrinking::No);
+		}
+		return *this;
+	}
+
+	FORCEINLINE friend uint32 GetTypeHash(const FAssetQuery& Query)
+	{
+		uint32 Hash = GetTypeHash(Query.Terms.Num());
+		for (const FAssetQueryTerm& Term : Query.Terms)
+		{
+			Hash = HashCombineFast(Hash, GetTypeHash(Term));
+		}
+		return Hash;
+	}
+
+	bool operator==(const FAssetQuery& Other) const
+	{
+		return Terms == Other.Terms;
+	}
+
+private:
+
+	FAssetQueryTerm& AddTerm(const EAssetQueryTermType Type)
+	{
+		if (!OpenGroups.IsEmpty())
+		{
+			++Terms[OpenGroups.Last()].NumChildren;
+		}
+		FAssetQueryTerm& Term = Terms.AddDefaulted_GetRef();
+		Term.Type = Type;
+		return Term;
+	}
+
+	/** Groups that are still being added to, while building in code */
+	TArray<int32, TInlineAllocator<4>> OpenGroups;
+};
+
+/** One key of a composite sort */
+USTRUCT(BlueprintType)
+struct FAssetSortKey
+{
+	GENERATED_BODY()
+
+	/** Items are ordered by their value for this tag. Items without it come after those with it. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	FGameplayTag Tag;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	bool bDescending = false;
+
+	bool operator==(const FAssetSortKey& Other) const
+	{
+		return Tag == Other.Tag && bDescending == Other.bDescending;
+	}
+};
+
+USTRUCT(Blueprintable, BlueprintType)
+struct FFilterAndSortCriterion
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	FGameplayTagContainer MustHaveTags;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	FGameplayTagContainer MustNotHaveTags;
+
+	/** Items must also match this, when it has terms */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	FAssetQuery Query;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	TArray<FGameplayTag> SortOrder;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	bool bSortValuesDescending = false;
+
+	/**
+	 * Sorts by each key in turn, used in place of SortOrder when set. Every filtered item is part of the order.
+	 * Items that tie on every key follow BaseOrder and then their unique Id.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	TArray<FAssetSortKey> SortKeys;
+
+	/** Unique Ids in the order to keep items in where the sort keys tie. Items not in it come after those in it. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
+	TArray<FName> BaseOrder;
+
+	FORCEINLINE bool UsesSortKeys() const { return !SortKeys.IsEmpty() || !BaseOrder.IsEmpty(); }
+};
+
+/** A row of a data table that a library can be built from. The row name is the item's unique Id. */
+USTRUCT(BlueprintType)
+struct FAwesomeAssetRow : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	/** List of assets to load*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Init Data")
+	TArray<FSoftObjectPath> SoftObjectPaths;
+
+	/** Tags that describe this asset for filtering and number values for sorting. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Init Data")
+	TMap<FGameplayTag, float> AssetDescriptions;
+};
+
+/**
+ * Collects the items of a new library in order, without hashing them into a set.
+ * Hand it over to UAwesomeAssetManager::BuildAssetLibrary to build the library on a worker thread.
+ */
+struct FItemLibraryBuilder
+{
+	void Reserve(const int32 NumItems) { Assets.Reserve(NumItems); }
+
+	/** Adds an item and returns it to be filled in */
+	FAssetInitializeData& AddItem(const FName UniqueId)
+	{
+		FAssetInitializeData& Asset = Assets.Emplace_GetRef();
+		Asset.UniqueId = UniqueId;
+		return Asset;
+	}
+
+	void AddItem(FAssetInitializeData&& Asset) { Assets.Emplace(MoveTemp(Asset)); }
+
+	/** Adds an item per row of a table of FAwesomeAssetRow rows, with the row name as its unique Id. Returns false if the rows are of another type. */
+	bool AddRows(const UDataTable& DataTable);
+
+	FORCEINLINE int32 Num() const { return Assets.Num(); }
+
+private:
+	TArray<FAssetInitializeData> Assets;
+
+	friend class UAwesomeAssetManager;
+	friend class FItemLibraryArchive;
+};
+
+/** A description value paired with the item it belongs to */
+struct FColumnEntry
+{
+	float Value;
+	int32 ItemIndex;
+};
+
+/** A library file mapped into memory, or read in where the platform can not map it. Description tables loaded from it view its sections in place. */
+struct FMappedLibraryFile
+{
+	TUniquePtr<IMappedFileHandle> Handle;
+
+	/** Declared after the handle so it is unmapped first */
+	TUniquePtr<IMappedFileRegion> Region;
+
+	/** The file's contents when it could not be mapped */
+	TArray64<uint8> Bytes;
+
+	FORCEINLINE TArrayView64<const uint8> GetBytes() const
+	{
+		return Region ? TArrayView64<const uint8>(Region->GetMappedPtr(), Region->GetMappedSize()) : TArrayView64<const uint8>(Bytes);
+	}
+};
+
+/**
+ * One array of a description table. It either views a section of a mapped library file, which stays mapped while it does, or shares its elements.
+ * Copying a table shares every array with the original. Elements are only copied, out of the file or the shared array, once the array is changed.
+ */
+template <typename T>
+class TTableArray
+{
+public:
+
+	FORCEINLINE const T* GetData() const { return File ? FileData : Owned ? Owned->GetData() : nullptr; }
+	FORCEINLINE int32 Num() const { return File ? FileNum : Owned ? Owned->Num() : 0; }
+
+	FORCEINLINE const T& operator[](const int32 Index) const
+	{
+		checkSlow(Index >= 0 && Index < Num());
+		return GetData()[Index];
+	}
+
+	FORCEINLINE operator TConstArrayView<T>() const { return MakeArrayView(GetData(), Num()); }
+
+	FORCEINLINE const T* begin() const { return GetData(); }
+	FORCEINLINE const T* end() const { return GetData() + Num(); }
+
+	/** The elements to change, copied first if the array views a file or shares them with another table */
+	TArray<T>& Edit()
+	{
+		if (File)
+		{
+			Owned = MakeShared<TArray<T>>(FileData, FileNum);
+			File.Reset();
+		}
+		else if (!Owned)
+		{
+			Owned = MakeShared<TArray<T>>();
+		}
+		else if (!Owned.IsUnique())
+		{
+			Owned = MakeShared<TArray<T>>(*Owned);
+		}
+		return *Owned;
+	}
+
+	/** Views a section of the mapped file in place of holding elements */
+	void View(const TSharedRef<const FMappedLibraryFile>& InFile, const TConstArrayView<T> Section)
+	{
+		Owned.Reset();
+		File = InFile;
+		FileData = Section.GetData();
+		FileNum = Section.Num();
+	}
+
+private:
+
+	/** Never changed while another table shares it */
+	TSharedPtr<TArray<T>> Owned;
+
+	/** Set while viewing a file */
+	TSharedPtr<const FMappedLibraryFile> File;
+	const T* FileData = nullptr;
+	int32 FileNum = 0;
+};
+
+/** A value of a description table that copies of the table share until one of them changes it */
+template <typename T>
+class TTableValue
+{
+public:
+
+	FORCEINLINE const T& operator*() const { return *Value; }
+	FORCEINLINE const T* operator->() const { return &Value.Get(); }
+
+	/** The value to change, copied first if another table shares it */
+	T& Edit()
+	{
+		if (!Value.IsUnique())
+		{
+			Value = MakeShared<T>(*Value);
+		}
+		return *Value;
+	}
+
+private:
+
+	/** Never changed while another table shares it */
+	TSharedRef<T> Value = MakeShared<T>();
+};
+
+/**
+ * Structure of arrays storage for the descriptions of every item in a library.
+ * Item N's values live at index N of every column so filtering and sorting only touch contiguous memory.
+ * This is immutable once built so it can be read from sorting tasks without locking.
+ * Copies share every array and the dictionary with the table they were copied from, and only copy what they change.
+ */
+struct FItemDescriptionTable
+{
+	/** Every description tag used by the library. The index of a tag is both its column and its bit in the tag masks. */
+	TTableArray<FGameplayTag> Tags;
+
+	/**
+	 * Tag dictionary for filtering. Holds every description tag at its column followed by the parents of those tags,
+	 * so an item's mask has the bits of its tags and all of their parents set.
+	 */
+	TTableValue<TMap<FGameplayTag, int32>> TagToBit;
+
+	/** Number of tags in the dictionary */
+	int32 NumBits = 0;
+
+	/** One column of values per description tag. A value is only meaningful if the item has the tag's bit set. */
+	TArray<TTableArray<float>> Columns;
+
+	/**
+	 * Per column, every item that has the tag in ascending order of its value. Sorting a filtered set is then a walk over these.
+	 * Negative values come first, NaNs come last and items with equal values stay in item order.
+	 */
+	TArray<TTableArray<FColumnEntry>> SortedColumns;
+
+	/** Packed tag bitmask per item. Item N's mask is the MaskWords words starting at N * MaskWords. */
+	TTableArray<uint64> TagMasks;
+
+	/** Number of 64 bit words in each item's mask */
+	int32 MaskWords = 0;
+
+	/** Number of items in the table, including removed ones */
+	int32 NumItems = 0;
+
+	/** Unique Id of every item, for breaking ties in composite sorts */
+	TTableArray<FName> UniqueIds;
+
+	/** Items that were removed from the library. They keep their index but have no tags and never pass a filter. */
+	TTableValue<TBitArray<>> RemovedItems;
+	int32 NumRemoved = 0;
+
+	/** Builds the table from the description maps of each item, in item index order. Unique Ids are left for the caller to fill in. */
+	void Build(TConstArrayView<TMap<FGameplayTag, float>> ItemDescriptions);
+
+	/** Stable LSD radix sort of entries by value, with the ordering described on SortedColumns */
+	static void RadixSortByValue(TArray<FColumnEntry>& Entries);
+
+	/**
+	 * Maps a value to an unsigned key with the ordering described on SortedColumns.
+	 * Negatives have every bit flipped and positives only the sign bit. Negative zero is folded into zero and every NaN gets the largest key.
+	 */
+	static FORCEINLINE uint32 GetSortKey(const float Value)
+	{
+		uint32 Bits = 0;
+		if (Value != 0.f)
+		{
+			FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+		}
+		return FMath::IsNaN(Value) ? MAX_uint32 : (Bits & 0x80000000u) ? ~Bits : Bits | 0x80000000u;
+	}
+
+	/** Does item A come before item B in the sorted order of the column */
+	FORCEINLINE bool IsSortedBefore(const int32 Column, const int32 ItemA, const int32 ItemB) const
+	{
+		const uint32 KeyA = GetSortKey(Columns[Column][ItemA]);
+		const uint32 KeyB = GetSortKey(Columns[Column][ItemB]);
+		return KeyA < KeyB || (KeyA == KeyB && ItemA < ItemB);
+	}
+
+	/** Returns true if every tag of the description already has a column, so it can be set without rebuilding */
+	bool HasColumns(const TMap<FGameplayTag, float>& Description) const;
+
+	/** Appends items without any description or unique Id */
+	void AddItems(const int32 NumNewItems);
+
+	/**
+	 * Replaces an item's description, keeping the masks and sorted columns up to date. Every tag must have a column.
+	 * Only the arrays whose values change are edited, so the rest stay shared with the table this one was copied from.
+	 */
+	void SetDescription(const int32 ItemIndex, const TMap<FGameplayTag, float>& Description);
+
+	/** Clears an item's description and marks it removed */
+	void RemoveItem(const int32 ItemIndex);
+
+	/** Reads back the description of an item */
+	void GetDescription(const int32 ItemIndex, TMap<FGameplayTag, float>& OutDescription) const;
+
+	FORCEINLINE bool IsRemoved(const int32 ItemIndex) const
+	{
+		return NumRemoved > 0 && (*RemovedItems)[ItemIndex];
+	}
+
+	/** Returns the dictionary bit of the tag or INDEX_NONE if no item in the library has it or a child of it */
+	FORCEINLINE int32 FindBit(const FGameplayTag& Tag) const
+	{
+		const int32* Bit = TagToBit->Find(Tag);
+		return Bit ? *Bit : INDEX_NONE;
+	}
+
+	/** Returns the column of the tag or INDEX_NONE if no item in the library uses it */
+	FORCEINLINE int32 FindColumn(const FGameplayTag& Tag) const
+	{
+		const int32 Bit = FindBit(Tag);
+		return Bit < Tags.Num() ? Bit : INDEX_NONE;
+	}
+
+	FORCEINLINE const uint64* GetMask(const int32 ItemIndex) const
+	{
+		return TagMasks.GetData() + static_cast<SIZE_T>(ItemIndex) * MaskWords;
+	}
+
+	FORCEINLINE bool HasColumn(const int32 ItemIndex, const int32 Column) const
+	{
+		return (GetMask(ItemIndex)[Column >> 6] >> (Column & 63)) & 1;
+	}
+};
+
+/** Lets a running filter and sort stop early once a newer one has been requested for its library */
+struct FSortCancellation
+{
+	/** The library's task counter, or null for work that can not be cancelled */
+	const std::atomic<int32>* TaskCounter = nullptr;
+	int32 TaskNumber = 0;
+
+	/** Items handled between two checks in the longer loops */
+	static constexpr int32 CheckInterval = 16 * 1024;
+
+	FORCEINLINE bool IsCancelled() const
+	{
+		return TaskCounter && TaskCounter->load(std::memory_order_relaxed) != TaskNumber;
+	}
+};
+
+/** Per description column, the filtered items that have it in ascending order of its values */
+using FSortedColumnCache = TMap<int32, TSharedPtr<const TArray<int32>>>;
+
+struct FSortResult;
+
+/**
+ * What a result that only has the start of its order laid out needs to lay out more of it.
+ * The order is continued by walking the pre-sorted columns of the table directly, without gathering them first.
+ * Shared by every extension of the result, so it is immutable once made.
+ */
+struct FLazySortState
+{
+	/** The table the result was filtered with */
+	TSharedPtr<const FItemDescriptionTable> Descriptions;
+
+	/** Columns of the sort order, INDEX_NONE for tags no item uses */
+	TArray<int32> SortColumns;
+
+	bool bDescending = false;
+
+	/** Items that pass the filter and have at least one sort column, so belong somewhere in the order */
+	TBitArray<> InOrder;
+
+	/** Turns a filtered result into one with only its first NumWanted items in order */
+	static void Begin(const TSharedRef<const FItemDescriptionTable>& Descriptions, const TArray<int32>& SortColumns, const bool bDescending, const int32 NumWanted, FSortResult& Result);
+
+	/** Continues the order of Result until it has at least NumWanted items, dropping the state once it is complete */
+	void Extend(FSortResult& Result, const int32 NumWanted) const;
+};
+
+/**
+ * One published filter and sort result of a library. Immutable once published, so tasks and readers share it without copying or locking.
+ * Parts that did not change are shared with the previous result.
+ */
+struct FSortResult
+{
+	/** Number of the task that produced this result. Newer results have larger numbers. */
+	int32 Generation = 0;
+
+	/** What the result was filtered and sorted by, so it can be kept up to date when items change */
+	FFilterAndSortCriterion Criterion;
+
+	/** The compiled filter that FilteredAssets was built with */
+	FTagMaskFilter Filter;
+
+	/** The compiled query that FilteredAssets was also built with, or null if the criterion had none */
+	TSharedPtr<const FQueryPlan> QueryPlan;
+
+	/** Indices of the library items that pass Filter, in ascending order */
+	TSharedRef<const TArray<int32>> FilteredAssets = MakeShared<TArray<int32>>();
+
+	/** Sorted columns of FilteredAssets. Kept so changing the sort order or direction does not sort again. */
+	FSortedColumnCache SortedColumnCache;
+
+	/** Indices of the sorted filtered items. Only the first of them until the result is complete. */
+	TArray<int32> SortedAssets;
+
+	/** Position of each library item in SortedAssets, or INDEX_NONE if it is not part of it or not laid out yet */
+	TArray<int32> SortedPositions;
+
+	/** Number of items in the full order */
+	int32 NumSorted = 0;
+
+	/** Set while only the start of the order is laid out */
+	TSharedPtr<const FLazySortState> LazyState;
+
+	/** Where laying out the order stopped. The sort column being walked and how many of its entries were walked. */
+	int32 LazyBucket = 0;
+	int32 LazyWalked = 0;
+
+	FORCEINLINE bool IsComplete() const { return !LazyState; }
+};
+
+/** Tuning for skewing a library's buffer toward the direction the user is scrolling */
+USTRUCT(BlueprintType)
+struct FPredictivePrefetchSettings
+{
+	GENERATED_BODY()
+
+	/** Skew the buffer toward the direction of travel and grade its priorities by distance. Off keeps the buffer symmetric. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch")
+	bool bEnabled = false;
+
+	/** Scroll speed, in items per second, at which the skew reaches MaxSkew */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch", meta=(ClampMin=1))
+	float FullSkewSpeed = 50.f;
+
+	/** Share of the buffer that can move ahead. 0 keeps it symmetric and 1 can move all of it ahead. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch", meta=(ClampMin=0, ClampMax=1))
+	float MaxSkew = 0.75f;
+
+	/** How much of the previous speed is kept on each new target. 0 only uses the latest movement. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch", meta=(ClampMin=0, ClampMax=1))
+	float VelocitySmoothing = 0.6f;
+
+	/** Seconds between targets after which scrolling counts as having stopped */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch", meta=(ClampMin=0))
+	float IdleResetTime = 0.3f;
+
+	/** Number of priority steps on each side of the buffer. Nearer items load with a higher priority. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Predictive Prefetch", meta=(ClampMin=1, ClampMax=8))
+	int32 NumPriorityGrades = 3;
+};
+
+/**
+ * The buffer as inclusive position ranges over a sorted order. The target range sits inside the buffer range.
+ * Each side of the buffer is split into priority grades by distance from the target.
+ */
+struct FBufferWindow
+{
+	/** Band of positions outside of the window */
+	static constexpr uint8 NoBand = 0;
+
+	/** Band of the target range */
+	static constexpr uint8 TargetBand = 1;
+
+	/** Buffer grades follow the target band, nearest to the target first */
+	static constexpr uint8 FirstBufferBand = 2;
+	
+	int32 BufferStart = 0;
+	int32 TargetStart = 0;
+	int32 TargetEnd = -1;
+	int32 BufferEnd = -1;
+
+	/** Buffer size before and after the target, before being clamped to the sorted order */
+	int32 FrontSize = 0;
+	int32 BackSize = 0;
+
+	int32 NumGrades = 1;
+
+	FORCEINLINE uint8 GetBand(const int32 Position) const
+	{
+		if (Position < BufferStart || Position > BufferEnd)
+		{
+			return NoBand;
+		}
+		if (Position < TargetStart)
+		{
+			return FirstBufferBand + GetGrade(TargetStart - Position, FrontSize);
+		}
+		if (Position > TargetEnd)
+		{
+			return FirstBufferBand + GetGrade(Position - TargetEnd, BackSize);
+		}
+		return TargetBand;
+	}
+
+	/** Adds every position at which the band can change */
+	template <typename AllocatorType>
+	void AddEdges(TArray<int32, AllocatorType>& Edges) const
+	{
+		Edges.Append({ BufferStart, TargetStart, TargetEnd + 1, BufferEnd + 1 });
+		for (int32 Grade = 1; Grade < NumGrades; ++Grade)
+		{
+			Edges.Emplace(TargetStart - Grade * FrontSize / NumGrades);
+			Edges.Emplace(TargetEnd + Grade * BackSize / NumGrades + 1);
+		}
+	}
+
+private:
+
+	/** Grade of a position Distance (1 or more) away from the target on a side of the given size */
+	FORCEINLINE uint8 GetGrade(const int32 Distance, const int32 SideSize) const
+	{
+		return SideSize > 0 ? static_cast<uint8>(FMath::Min((Distance * NumGrades - 1) / SideSize, NumGrades - 1)) : 0;
+	}
+};
+
+/** A set of changes to apply to an existing library at once */
+struct FItemLibraryChanges
+{
+	/** Items to append */
+	TArray<FAssetInitializeData> Added;
+
+	/** Indices of items to remove */
+	TArray<int32> Removed;
+
+	/** Indices of items with the descriptions to replace theirs with */
+	TArray<TPair<int32, TMap<FGameplayTag, float>>> Updated;
+};
+
+/** Items of a band that were issued together. They share one streamable request for the paths they were missing. */
+struct FLoadBatch
+{
+	/** Items the batch is waiting on. Members leave once notified. An item that left otherwise no longer points at this batch. */
+	TArray<int32> Members;
+
+	/** Kept until every member has left so that its completion still reaches them. Null if every path was in flight already. */
+	TSharedPtr<FPathRegistry::FPathRequest> Request;
+
+	/** Requests of earlier batches that were already loading some of the members' paths. Kept for the same reason. */
+	FPathRegistry::FWaitRequests WaitingOn;
+
+	/** Priority of the band the batch was issued for */
+	TAsyncLoadPriority Priority = FStreamableManager::DefaultAsyncLoadPriority;
+};
+
+/**
+ * Describes each item to be tracked and have its dependencies loaded. Description values are kept in the library's FItemDescriptionTable
+ * and the paths to load in the library's ItemPaths, so an item owns no allocations of its own.
+ */
 struct FAwesomeAssetData
 {
 	FAwesomeAssetData() = delete;
 	FAwesomeAssetData(const FAwesomeAssetData&) = delete;
 	
-	explicit FAwesomeAssetData(FAssetInitializeData&& InitData)
+	/** Moves the paths to load to the end of PathArena */
+	FAwesomeAssetData(FAssetInitializeData&& InitData, TArray<FSoftObjectPath>& PathArena)
 	{
 		UniqueId = InitData.UniqueId;
-		AssetsToLoad = MoveTemp(InitData.SoftObjectPaths);
-		AssetDescriptions = MoveTemp(InitData.AssetDescriptions);
-		TArray<FGameplayTag> Keys;
-		AssetDescriptions.GenerateKeyArray(Keys);
-		CachedAssetDescriptionTags = FGameplayTagContainer::CreateFromArray(Keys);
+		FirstPath = PathArena.Num();
+		NumPaths = InitData.SoftObjectPaths.Num();
+		for (FSoftObjectPath& Path : InitData.SoftObjectPaths)
+		{
+			PathArena.Emplace(MoveTemp(Path));
+		}
 		OnStatusChange = MoveTemp(InitData.OnStatusChange);
 	}
 
 	/** Unique identifier for this asset. Can leave blank if assets are just referenced by list index. */
 	FName UniqueId;
 
-	/** List of assets to load*/
-	TSet<FSoftObjectPath> AssetsToLoad;
-
-	/** Tags that describe this asset for filtering and number values for sorting. */
-	TMap<FGameplayTag, float> AssetDescriptions;
-
-	/** Cached tags for faster filtering */
-	FGameplayTagContainer CachedAssetDescriptionTags;
+	/** Range of the library's ItemPaths with the assets to load */
+	int32 FirstPath = 0;
+	int32 NumPaths = 0;
 
 	/** Delegate handles to call when the load status of this changes */
 	FOnStatusChange OnStatusChange;
 
-	/** Handle to keep the assets alive that this asset depends on */
-	TSharedPtr<FStreamableHandle> LoadHandle;
+	/** The batch this asset was issued with. Only set while in the buffer. */
+	TSharedPtr<FLoadBatch> LoadBatch;
+
+	/** Holds a reference to each of its paths in the path registry, which keeps them loaded */
+	bool bPathsHeld = false;
+
+	/** The band of the buffer this asset was last requested for. See FBufferWindow. */
+	uint8 LoadBand = FBufferWindow::NoBand;
+
+	/** Out of the buffer but its loaded paths are parked in the residency cache */
+	bool bResident = false;
+
+	/** Removed from the library. The item keeps its index so nothing else has to be renumbered. */
+	bool bRemoved = false;
+
+	/** Waiting in the status dispatcher to deliver bQueuedStatus */
+	bool bStatusQueued = false;
+	bool bQueuedStatus = false;
+
+	/** The status OnStatusChange was last called with */
+	bool bDeliveredStatus = false;
 };
 
 
-class FItemLibrary : public TSharedFromThis<FItemLibrary>
+class FItemLibrary;
+
+/**
+ * One filtered and sorted order over the items of a library, with its own buffer target.
+ * A library has a default view under its own name and can host more, which share its items and their loads.
+ */
+class FLibraryView : public TSharedFromThis<FLibraryView>
 {
 public:
 
-	/** Sets up initial variables */
-	void Initialize(FName LibraryName, TSet<FAssetInitializeData>&& NewAssets);
+	/** Starts out with every item of the library, unsorted */
+	FLibraryView(FItemLibrary& InLibrary, FName InName);
+	~FLibraryView();
 
 private:
-	FName Name;
 
-	void Update();
-	
 	friend class UAwesomeAssetManager;
+	friend class FItemLibrary;
+	friend class FSortedAssetView;
 
-	std::atomic<int32> TaskCounter;
+	/** The library the view belongs to. Null once the view is removed or its library is shut down, after which only tasks and tickers still hold it. */
+	FItemLibrary* Library;
+
+	FName Name;
+
+	std::atomic<int32> TaskCounter { 0 };
 
 	UE::Tasks::FTask SortAndFilterTask;
 
+	/** Asynchronous requests wait this long for later ones so that a burst of them is filtered and sorted once. 0 starts each right away. */
+	float DebounceSeconds = 0.f;
 
-	//~ Start lockables
-	FCriticalSection Lock;
-	
-	/** All items belonging to this library */
-	TSet<TSharedPtr<FAwesomeAssetData>> Items;
+	/** The latest request while waiting out the debounce window */
+	FFilterAndSortCriterion DebouncedCriterion;
+	FSimpleDelegate DebouncedOnComplete;
+	FTSTicker::FDelegateHandle DebounceTickerHandle;
 
-	FGameplayTagContainer MustHaveTagsCache;
-	FGameplayTagContainer MustNotHaveTagsCache;
-	
-	/** Library items that are part of the last set filter */
-	TSet<TSharedPtr<FAwesomeAssetData>> FilteredAssets;
+	/** The latest asynchronous request until its OnComplete is called, so a change to the library's items can start it again rather than drop it */
+	TOptional<FFilterAndSortCriterion> InFlightCriterion;
+	FSimpleDelegate InFlightOnComplete;
 
-	/** The sorted filtered items */
-	TArray<TSharedPtr<FAwesomeAssetData>> SortedAssets;
+	/** Tasks that stopped because a newer request superseded them */
+	std::atomic<int32> NumCancelledTasks { 0 };
 
-	//~ End lockables
-	
+	/** Requests that were replaced by a later one in the same debounce window */
+	int32 NumCoalescedRequests = 0;
+
+	/**
+	 * Asynchronous requests first publish a result with only the buffer's part of the order laid out, then finish sorting on the same task.
+	 * The game thread lays out more of the order itself if the buffer moves past it before then.
+	 */
+	bool bLazySort = false;
+
+	/** Least number of items a lazy sort lays out at first */
+	static constexpr int32 MinLazySorted = 1024;
+
+	/** Number of items a lazy sort lays out at first, enough for the buffer around the current target */
+	FORCEINLINE int32 GetNumLazySorted() const
+	{
+		const int32 BufferEnd = bHasBufferTarget ? TargetEnd + 2 * BufferSize + 1 : 0;
+		return FMath::Max(BufferEnd, MinLazySorted);
+	}
+
+
+	/** The latest result the game thread has adopted. Only touched on the game thread. */
+	TSharedRef<const FSortResult> Result;
+
+	/** A result finished by a task that the game thread has not adopted yet. Owned by whoever exchanges it out. */
+	std::atomic<FSortResult*> PendingResult { nullptr };
+
+	/** Returns the latest result, adopting one a task has finished since the last call. Game thread only, never waits. */
+	const TSharedRef<const FSortResult>& GetResult();
+
+	/** Hands a finished result over to the game thread. Safe from any thread. */
+	void PublishResult(TUniquePtr<FSortResult> NewResult);
+
+	/** Re-applies the buffer target if it was last applied to an older result. Game thread only. */
+	void RefreshBuffer();
+
+	/**
+	 * Lays out at least the first NumWanted items of the order of Current, a result taken from GetResult, if it is not complete.
+	 * Returns Current or the extended copy of it that replaces it, never a newer result. Game thread only.
+	 */
+	TSharedRef<const FSortResult> EnsureSorted(const TSharedRef<const FSortResult> Current, const int32 NumWanted);
+
+	/** Position of the item in the latest result's order, laying out the order up to it first if needed. Game thread only. */
+	int32 FindSortedPosition(const int32 ItemIndex);
 
 	
 	//~~~~ For the buffer ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-	
-	TSet<TSharedPtr<FAwesomeAssetData>> RequestedAssets;
+	/** Has a buffer target been set yet */
+	bool bHasBufferTarget = false;
+
+	/** The result the buffer was last applied to */
+	TSharedPtr<const FSortResult> BufferResult;
+
+	/** The window that was last applied, over the order of BufferResult */
+	FBufferWindow BufferWindow;
+
+	/** The band of the window each library item is in for this view. Items load at the nearest band any view has for them. */
+	TArray<uint8> ItemBands;
 
 	/** Number of assets above and bellow the target range to load. this is a default priority load */
 	int32 BufferSize = 0;
@@ -152,6 +930,235 @@ private:
 	int32 TargetStart = 0;
 	int32 TargetEnd = 0;
 
-	/** Returns all the assets that should be loaded */
-	void GetRequestedAssets(TSet<TSharedPtr<FAwesomeAssetData>>& HighPriority, TSet<TSharedPtr<FAwesomeAssetData>>& DefaultPriority);
+	/** Tuning for skewing the buffer toward the direction of travel */
+	FPredictivePrefetchSettings PredictiveSettings;
+
+	/** Smoothed speed of the target's center in items per second. Positive is toward the end of the sorted order. */
+	float ScrollVelocity = 0.f;
+
+	/** When the target was last set */
+	double LastTargetTime = 0.0;
+
+	/** Sets the buffer target and tracks how fast it is moving */
+	void SetBufferTarget(const int32 NewTargetStart, const int32 NewTargetEnd, const int32 NewBufferSize);
+
+	/** Clamps the buffer target to a sorted order of the given size */
+	FBufferWindow MakeBufferWindow(const int32 NumSorted) const;
+
+	/** Moves the view's window to the buffer target over the latest result, or empties it if there is no target */
+	void Update();
+
+	/** Lets go of the view's window, as when it is removed */
+	void ReleaseBuffer();
+
+	/** Drops its running and debounced requests, releases its window and lets go of the library. Game thread only. */
+	void Detach();
+};
+
+class FItemLibrary : public TSharedFromThis<FItemLibrary>
+{
+public:
+
+	~FItemLibrary();
+
+	/**
+	 * Lets go of everything the library holds in what the manager shares: loads, paths, parked items and queued status changes.
+	 * Called on the game thread when the library is removed or replaced, since a sorting task may drop the last reference on a worker thread.
+	 */
+	void Shutdown();
+
+	/** Sets up initial variables */
+	void Initialize(FName LibraryName, TSet<FAssetInitializeData>&& NewAssets);
+	void Initialize(FName LibraryName, TArray<FAssetInitializeData>&& NewAssets);
+
+	/** Sets up from descriptions that were built already, in which case the assets' descriptions are ignored */
+	void Initialize(FName LibraryName, TArray<FAssetInitializeData>&& NewAssets, const TSharedRef<const FItemDescriptionTable>& PrebuiltDescriptions);
+
+	/** Libraries with at least this many items filter and sort in parallel when set to automatic */
+	static constexpr int32 ParallelFilterAndSortThreshold = 16 * 1024;
+
+	/** Number of items each parallel filtering and bucketing job handles */
+	static constexpr int32 ParallelChunkSize = 4 * 1024;
+
+private:
+	FName Name;
+
+	/** Moves the assets into the library and builds everything derived from them. Does not touch the game thread. */
+	template <typename AssetContainerType>
+	void InitializeFrom(FName LibraryName, AssetContainerType& NewAssets, const TSharedPtr<const FItemDescriptionTable>& PrebuiltDescriptions);
+
+	/** When filtering and sorting should go parallel */
+	EParallelFilterAndSort ParallelFilterAndSort = EParallelFilterAndSort::Automatic;
+
+	FORCEINLINE bool ShouldFilterAndSortInParallel() const
+	{
+		return ParallelFilterAndSort == EParallelFilterAndSort::Always
+			|| (ParallelFilterAndSort == EParallelFilterAndSort::Automatic && Items.Num() >= ParallelFilterAndSortThreshold);
+	}
+
+	/** Issues queued loads as batches, nearest band first, until the issue budget is spent. Returns true if some are left. */
+	bool IssuePendingLoads();
+	
+	/** Async load priority of a buffer band */
+	static TAsyncLoadPriority GetBandPriority(const uint8 Band);
+	
+	friend class UAwesomeAssetManager;
+	friend class FResidencyCache;
+	friend class FStatusDispatcher;
+	friend class FItemLibraryArchive;
+	friend class FSortedAssetView;
+	friend class FLibraryView;
+
+	/** All items belonging to this library. An item's index in this array is how it is referenced everywhere else. */
+	TArray<FAwesomeAssetData> Items;
+
+	/** Description values of the items. Shared with sorting tasks. */
+	TSharedPtr<const FItemDescriptionTable> Descriptions;
+
+	/** Queries compiled against the tag dictionary of Descriptions. Shared with sorting tasks. */
+	TSharedPtr<FQueryPlanCache> QueryPlans;
+
+	/** Paths to load of every item back to back, in item order. See FAwesomeAssetData::FirstPath. */
+	TArray<FSoftObjectPath> ItemPaths;
+
+	/** The paths an item loads */
+	FORCEINLINE TConstArrayView<FSoftObjectPath> GetPaths(const FAwesomeAssetData& Item) const
+	{
+		return MakeArrayView(ItemPaths.GetData() + Item.FirstPath, Item.NumPaths);
+	}
+
+	/** Lookup from an item's unique Id to its index. Items without an Id are not in here. */
+	TMap<FName, int32> UniqueIdToItem;
+
+	/** Returns the index of the item with the unique Id or INDEX_NONE */
+	FORCEINLINE int32 FindItem(const FName& UniqueId) const
+	{
+		const int32* ItemIndex = UniqueIdToItem.Find(UniqueId);
+		return ItemIndex ? *ItemIndex : INDEX_NONE;
+	}
+
+	/** Every item that is not removed, unsorted, as a view starts out with */
+	TSharedRef<FSortResult> MakeInitialResult() const;
+
+
+	//~~~~ For views ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/** The default view first, which has the library's name */
+	TArray<TSharedRef<FLibraryView>> Views;
+
+	FORCEINLINE const TSharedRef<FLibraryView>& GetDefaultView() const { return Views[0]; }
+
+	/** Adds a view with every item unsorted */
+	TSharedRef<FLibraryView> AddView(FName ViewName);
+
+	/** Releases the view's window and removes it. The default view can not be removed. */
+	void RemoveView(const TSharedRef<FLibraryView>& View);
+
+	/** Nearest band any view has for the item */
+	uint8 GetNearestBand(const int32 ItemIndex) const;
+
+	/** Upper bound on FPredictivePrefetchSettings::NumPriorityGrades */
+	static constexpr int32 MaxPriorityGrades = 8;
+
+	/** Items whose band changed in one view, indexed by their new band in it */
+	using FBandChanges = TArray<TArray<int32>, TInlineAllocator<FBufferWindow::FirstBufferBand + MaxPriorityGrades>>;
+
+	/** Stores a view's band changes and loads, promotes or unloads the items whose nearest band across every view changed */
+	void ChangeBands(FLibraryView& View, const FBandChanges& ToChange);
+
+	
+	//~~~~ For loading ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/** Most items issued as one streamable request */
+	static constexpr int32 MaxBatchSize = 64;
+
+	/** Seconds a frame may spend issuing loads. At least one batch is processed per frame. */
+	float IssueBudgetSeconds = 0.002f;
+
+	/** Items waiting to be issued, indexed by band. Entries whose item has since changed band or got a load are skipped. */
+	TArray<TArray<int32>> PendingLoads;
+
+	/** Keeps issuing on later frames while loads are pending */
+	FTSTicker::FDelegateHandle IssueTickerHandle;
+
+
+	//~~~~ For the residency cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/** Shared by every library of the manager. Items leaving the buffer park their loaded handle in here. */
+	TSharedPtr<FResidencyCache> ResidencyCache;
+
+	/** Parks the item's paths if they have loaded, otherwise releases them */
+	void ParkOrRelease(FAwesomeAssetData& Item, const int32 ItemIndex);
+
+	/** Releases the paths of a parked item. Called by the cache when evicting it. */
+	void ReleaseResident(const int32 ItemIndex);
+
+	/** Lets go of the item's references in the path registry */
+	void ReleasePaths(FAwesomeAssetData& Item);
+
+	/** Shared by every library of the manager. Items hold their paths in here while buffered or parked. */
+	TSharedPtr<FPathRegistry> PathRegistry;
+
+
+	//~~~~ For status changes ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/** Shared by every library of the manager. Queues status changes when enabled. */
+	TSharedPtr<FStatusDispatcher> StatusDispatcher;
+
+	/** Notifies the members of the batch whose paths have all loaded and takes them out of it */
+	void NotifyLoadedMembers(FLoadBatch& Batch);
+
+	/** Calls the item's OnStatusChange now, or through the dispatcher if it is enabled */
+	void NotifyStatus(const int32 ItemIndex, const bool bLoaded);
+
+	/** Estimated memory kept alive by an item's loaded assets */
+	int64 EstimateResidentSize(const FAwesomeAssetData& Item) const;
+};
+
+/**
+ * A range of a view's sorted order, read in place from the result it was made from. Reading it does not allocate or copy.
+ * It holds on to that result, so it does not change when newer results come in. Compare generations to tell whether it is stale.
+ */
+class FSortedAssetView
+{
+public:
+
+	FSortedAssetView() = default;
+
+	/** Views Count positions from Start of the view's latest result, laying out that much of a lazily sorted order first */
+	FSortedAssetView(FLibraryView& View, const int32 InStart, const int32 Count)
+		: Library(View.Library->AsShared())
+	{
+		// The range is clamped to the same result it is read from
+		const TSharedRef<const FSortResult> Current = View.GetResult();
+		Start = FMath::Clamp(InStart, 0, Current->NumSorted);
+		const int32 End = FMath::Clamp(Start + FMath::Max(Count, 0), Start, Current->NumSorted);
+		Result = View.EnsureSorted(Current, End);
+		ItemIndices = MakeArrayView(Result->SortedAssets.GetData() + Start, End - Start);
+	}
+
+	/** Number of positions in the view */
+	FORCEINLINE int32 Num() const { return ItemIndices.Num(); }
+
+	/** Sorted position of the first item in the view */
+	FORCEINLINE int32 GetStart() const { return Start; }
+
+	/** Number of items in the full order the view is a range of */
+	FORCEINLINE int32 GetNumSorted() const { return Result ? Result->NumSorted : 0; }
+
+	/** Generation of the result the view reads from */
+	FORCEINLINE int32 GetGeneration() const { return Result ? Result->Generation : INDEX_NONE; }
+
+	/** Library item indices in sorted order */
+	FORCEINLINE TConstArrayView<int32> GetItemIndices() const { return ItemIndices; }
+
+	/** Unique Id of the item at a position of the view */
+	FORCEINLINE FName operator[](const int32 Index) const { return Library->Items[ItemIndices[Index]].UniqueId; }
+
+private:
+
+	TSharedPtr<FItemLibrary> Library;
+	TSharedPtr<const FSortResult> Result;
+	TConstArrayView<int32> ItemIndices;
+	int32 Start = 0;
 };
\ No newline at end of file
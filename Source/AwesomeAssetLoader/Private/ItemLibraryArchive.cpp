@@ -0,0 +1,352 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemLibraryArchive.h"
+#include "ItemLibrary.h"
+#include "AwesomeAssetManager.h"
+#include "AwesomeAssetLoaderSettings.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+
+
+namespace ItemLibraryArchive
+{
+	/** Views Num elements of T at Offset, or clears bValid if they do not fit in the file */
+	template <typename T>
+	TConstArrayView<T> GetSection(const TArrayView64<const uint8> Bytes, const uint64 Offset, const int64 Num, bool& bValid)
+	{
+		if (!bValid || Num < 0 || Num > MAX_int32 || Offset % alignof(T) != 0 || Offset > static_cast<uint64>(Bytes.Num())
+			|| (static_cast<uint64>(Bytes.Num()) - Offset) / sizeof(T) < static_cast<uint64>(Num))
+		{
+			bValid = false;
+			return TConstArrayView<T>();
+		}
+		return MakeArrayView(reinterpret_cast<const T*>(Bytes.GetData() + Offset), static_cast<int32>(Num));
+	}
+
+	/** Pads to the next multiple of 8 and returns the offset of what is appended next */
+	uint64 StartSection(TArray<uint8>& Bytes)
+	{
+		Bytes.AddZeroed(Align(Bytes.Num(), 8) - Bytes.Num());
+		return Bytes.Num();
+	}
+
+	template <typename T>
+	void AppendSection(TArray<uint8>& Bytes, const TConstArrayView<T> Data)
+	{
+		Bytes.Append(reinterpret_cast<const uint8*>(Data.GetData()), Data.Num() * sizeof(T));
+	}
+}
+
+bool FItemLibraryArchive::Save(const FItemLibrary& Library, const FString& FilePath)
+{
+	using namespace ItemLibraryArchive;
+
+	// Removed items are left out of the file, so a library that has some saves a table built again from the rest
+	TSharedPtr<const FItemDescriptionTable> LiveDescriptions = Library.Descriptions;
+	if (LiveDescriptions->NumRemoved > 0)
+	{
+		TArray<TMap<FGameplayTag, float>> ItemDescriptions;
+		ItemDescriptions.Reserve(Library.Items.Num() - LiveDescriptions->NumRemoved);
+		for (int32 ItemIndex = 0; ItemIndex < Library.Items.Num(); ++ItemIndex)
+		{
+			if (!Library.Items[ItemIndex].bRemoved)
+			{
+				LiveDescriptions->GetDescription(ItemIndex, ItemDescriptions.Emplace_GetRef());
+			}
+		}
+		
+		const TSharedRef<FItemDescriptionTable> Compacted = MakeShared<FItemDescriptionTable>();
+		Compacted->Build(ItemDescriptions);
+		LiveDescriptions = Compacted;
+	}
+	const FItemDescriptionTable& Descriptions = *LiveDescriptions;
+
+	// Strings are deduplicated so paths shared between items are only stored once
+	TArray<FString> Strings;
+	TMap<FString, int32> StringIndices;
+	const auto AddString = [&Strings, &StringIndices](FString&& String)
+	{
+		if (const int32* Existing = StringIndices.Find(String))
+		{
+			return *Existing;
+		}
+		StringIndices.Emplace(String, Strings.Num());
+		return Strings.Emplace(MoveTemp(String));
+	};
+
+	TArray<int32> TagBits;
+	TagBits.SetNumZeroed(Descriptions.NumBits);
+	for (const TPair<FGameplayTag, int32>& TagBit : *Descriptions.TagToBit)
+	{
+		TagBits[TagBit.Value] = AddString(TagBit.Key.ToString());
+	}
+
+	TArray<FItemRecord> ItemRecords;
+	TArray<int32> ItemPaths;
+	ItemRecords.Reserve(Library.Items.Num());
+	for (const FAwesomeAssetData& Item : Library.Items)
+	{
+		if (Item.bRemoved)
+		{
+			continue;
+		}
+		
+		FItemRecord& Record = ItemRecords.Emplace_GetRef();
+		Record.UniqueId = Item.UniqueId.IsNone() ? INDEX_NONE : AddString(Item.UniqueId.ToString());
+		Record.FirstPath = ItemPaths.Num();
+		Record.NumPaths = Item.NumPaths;
+		for (const FSoftObjectPath& Path : Library.GetPaths(Item))
+		{
+			ItemPaths.Emplace(AddString(Path.ToString()));
+		}
+	}
+
+	TArray<uint32> StringOffsets;
+	TArray<uint8> StringData;
+	StringOffsets.Reserve(Strings.Num() + 1);
+	for (const FString& String : Strings)
+	{
+		StringOffsets.Emplace(StringData.Num());
+		const FTCHARToUTF8 Converted(*String);
+		StringData.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	}
+	StringOffsets.Emplace(StringData.Num());
+
+	TArray<int32> SortedCounts;
+	for (const TTableArray<FColumnEntry>& SortedColumn : Descriptions.SortedColumns)
+	{
+		SortedCounts.Emplace(SortedColumn.Num());
+	}
+
+	FHeader Header;
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.NumItems = Descriptions.NumItems;
+	Header.NumTags = Descriptions.Tags.Num();
+	Header.NumBits = Descriptions.NumBits;
+	Header.MaskWords = Descriptions.MaskWords;
+	Header.NumStrings = Strings.Num();
+	Header.NumItemPaths = ItemPaths.Num();
+
+	TArray<uint8> Bytes;
+	Bytes.AddZeroed(sizeof(FHeader));
+	Header.StringOffsetsOffset = StartSection(Bytes);
+	AppendSection<uint32>(Bytes, StringOffsets);
+	Header.StringDataOffset = StartSection(Bytes);
+	AppendSection<uint8>(Bytes, StringData);
+	Header.TagBitsOffset = StartSection(Bytes);
+	AppendSection<int32>(Bytes, TagBits);
+	Header.MasksOffset = StartSection(Bytes);
+	AppendSection<uint64>(Bytes, Descriptions.TagMasks);
+	Header.ColumnsOffset = StartSection(Bytes);
+	for (const TTableArray<float>& Column : Descriptions.Columns)
+	{
+		AppendSection<float>(Bytes, Column);
+	}
+	Header.SortedCountsOffset = StartSection(Bytes);
+	AppendSection<int32>(Bytes, SortedCounts);
+	Header.SortedEntriesOffset = StartSection(Bytes);
+	for (const TTableArray<FColumnEntry>& SortedColumn : Descriptions.SortedColumns)
+	{
+		AppendSection<FColumnEntry>(Bytes, SortedColumn);
+	}
+	Header.ItemsOffset = StartSection(Bytes);
+	AppendSection<FItemRecord>(Bytes, ItemRecords);
+	Header.ItemPathsOffset = StartSection(Bytes);
+	AppendSection<int32>(Bytes, ItemPaths);
+
+	FMemory::Memcpy(Bytes.GetData(), &Header, sizeof(FHeader));
+	return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+TSharedPtr<FItemLibrary> FItemLibraryArchive::Load(FName LibraryName, const FString& FilePath)
+{
+	using namespace ItemLibraryArchive;
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+
+	// Map the file where the platform can, otherwise read it in. Either way the table views it in place and keeps it for as long as it does.
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const TSharedRef<FMappedLibraryFile> File = MakeShared<FMappedLibraryFile>();
+	File->Handle.Reset(PlatformFile.OpenMapped(*FilePath));
+	File->Region.Reset(File->Handle ? File->Handle->MapRegion(0, File->Handle->GetFileSize()) : nullptr);
+	if (!File->Region && !FFileHelper::LoadFileToArray(File->Bytes, *FilePath))
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to open library file %s"), *FilePath)
+		return nullptr;
+	}
+	const TArrayView64<const uint8> Bytes = File->GetBytes();
+
+	FHeader Header;
+	if (Bytes.Num() < static_cast<int64>(sizeof(FHeader)))
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library file %s is not valid"), *FilePath)
+		return nullptr;
+	}
+	FMemory::Memcpy(&Header, Bytes.GetData(), sizeof(FHeader));
+	if (Header.Magic != Magic || Header.Version != Version)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library file %s is not valid or is from another version"), *FilePath)
+		return nullptr;
+	}
+
+	bool bValid = Header.NumItems >= 0 && Header.NumTags >= 0 && Header.NumTags <= Header.NumBits && Header.NumStrings >= 0
+		&& Header.MaskWords == FMath::Max(1, FMath::DivideAndRoundUp(Header.NumBits, 64));
+	const TConstArrayView<uint32> StringOffsets = GetSection<uint32>(Bytes, Header.StringOffsetsOffset, static_cast<int64>(Header.NumStrings) + 1, bValid);
+	const TConstArrayView<uint8> StringData = GetSection<uint8>(Bytes, Header.StringDataOffset, bValid ? StringOffsets.Last() : 0, bValid);
+	const TConstArrayView<int32> TagBits = GetSection<int32>(Bytes, Header.TagBitsOffset, Header.NumBits, bValid);
+	const TConstArrayView<uint64> Masks = GetSection<uint64>(Bytes, Header.MasksOffset, static_cast<int64>(Header.NumItems) * Header.MaskWords, bValid);
+	const TConstArrayView<float> Columns = GetSection<float>(Bytes, Header.ColumnsOffset, static_cast<int64>(Header.NumTags) * Header.NumItems, bValid);
+	const TConstArrayView<int32> SortedCounts = GetSection<int32>(Bytes, Header.SortedCountsOffset, Header.NumTags, bValid);
+	int64 NumSortedEntries = 0;
+	for (const int32 SortedCount : SortedCounts)
+	{
+		bValid &= SortedCount >= 0 && SortedCount <= Header.NumItems;
+		NumSortedEntries += SortedCount;
+	}
+	const TConstArrayView<FColumnEntry> SortedEntries = GetSection<FColumnEntry>(Bytes, Header.SortedEntriesOffset, NumSortedEntries, bValid);
+	const TConstArrayView<FItemRecord> ItemRecords = GetSection<FItemRecord>(Bytes, Header.ItemsOffset, Header.NumItems, bValid);
+	const TConstArrayView<int32> ItemPaths = GetSection<int32>(Bytes, Header.ItemPathsOffset, Header.NumItemPaths, bValid);
+
+	// Indices are checked once here so everything below can trust them
+	for (int32 String = 0; bValid && String < Header.NumStrings; ++String)
+	{
+		bValid &= StringOffsets[String] <= StringOffsets[String + 1];
+	}
+	for (const int32 StringIndex : TagBits)
+	{
+		bValid &= StringIndex >= 0 && StringIndex < Header.NumStrings;
+	}
+	for (const int32 StringIndex : ItemPaths)
+	{
+		bValid &= StringIndex >= 0 && StringIndex < Header.NumStrings;
+	}
+	for (const FItemRecord& Record : ItemRecords)
+	{
+		bValid &= Record.UniqueId >= INDEX_NONE && Record.UniqueId < Header.NumStrings
+			&& Record.FirstPath >= 0 && Record.NumPaths >= 0 && Record.FirstPath <= ItemPaths.Num() - Record.NumPaths;
+	}
+	for (const FColumnEntry& Entry : SortedEntries)
+	{
+		bValid &= Entry.ItemIndex >= 0 && Entry.ItemIndex < Header.NumItems;
+	}
+	if (!bValid)
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library file %s is not valid"), *FilePath)
+		return nullptr;
+	}
+
+	const auto GetString = [&StringOffsets, &StringData](const int32 StringIndex)
+	{
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(StringData.GetData() + StringOffsets[StringIndex]), StringOffsets[StringIndex + 1] - StringOffsets[StringIndex]);
+		return FString(Converted.Length(), Converted.Get());
+	};
+
+	// The table's arrays view the file's sections, which are laid out exactly as built, so they are neither copied nor parsed.
+	// Pages of a mapped file are shared with every other process that maps it.
+	const TSharedRef<FItemDescriptionTable> Descriptions = MakeShared<FItemDescriptionTable>();
+	Descriptions->NumItems = Header.NumItems;
+	Descriptions->NumBits = Header.NumBits;
+	Descriptions->MaskWords = Header.MaskWords;
+	TArray<FName>& UniqueIds = Descriptions->UniqueIds.Edit();
+	UniqueIds.Reserve(Header.NumItems);
+	TArray<FGameplayTag>& Tags = Descriptions->Tags.Edit();
+	TMap<FGameplayTag, int32>& TagToBit = Descriptions->TagToBit.Edit();
+	TagToBit.Reserve(Header.NumBits);
+	for (int32 Bit = 0; Bit < Header.NumBits; ++Bit)
+	{
+		const FGameplayTag Tag = FGameplayTag::RequestGameplayTag(FName(GetString(TagBits[Bit])), false);
+		if (!Tag.IsValid())
+		{
+			UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Library file %s uses the tag %s which no longer exists"), *FilePath, *GetString(TagBits[Bit]))
+			return nullptr;
+		}
+		if (Bit < Header.NumTags)
+		{
+			Tags.Emplace(Tag);
+		}
+		TagToBit.Emplace(Tag, Bit);
+	}
+	Descriptions->TagMasks.View(File, Masks);
+	Descriptions->Columns.SetNum(Header.NumTags);
+	Descriptions->SortedColumns.SetNum(Header.NumTags);
+	int32 FirstSortedEntry = 0;
+	for (int32 Column = 0; Column < Header.NumTags; ++Column)
+	{
+		Descriptions->Columns[Column].View(File, Columns.Slice(Column * Header.NumItems, Header.NumItems));
+		Descriptions->SortedColumns[Column].View(File, SortedEntries.Slice(FirstSortedEntry, SortedCounts[Column]));
+		FirstSortedEntry += SortedCounts[Column];
+	}
+
+	// Each unique path is only converted once
+	TArray<FSoftObjectPath> Paths;
+	TBitArray<> PathMade(false, Header.NumStrings);
+	Paths.SetNum(Header.NumStrings);
+	
+	TArray<FAssetInitializeData> Assets;
+	Assets.SetNum(Header.NumItems);
+	for (int32 ItemIndex = 0; ItemIndex < Header.NumItems; ++ItemIndex)
+	{
+		const FItemRecord& Record = ItemRecords[ItemIndex];
+		FAssetInitializeData& Asset = Assets[ItemIndex];
+		Asset.UniqueId = Record.UniqueId == INDEX_NONE ? NAME_None : FName(GetString(Record.UniqueId));
+		UniqueIds.Emplace(Asset.UniqueId);
+		Asset.SoftObjectPaths.Reserve(Record.NumPaths);
+		for (const int32 StringIndex : ItemPaths.Slice(Record.FirstPath, Record.NumPaths))
+		{
+			if (!PathMade[StringIndex])
+			{
+				Paths[StringIndex] = FSoftObjectPath(GetString(StringIndex));
+				PathMade[StringIndex] = true;
+			}
+			Asset.SoftObjectPaths.Emplace(Paths[StringIndex]);
+		}
+	}
+
+	const TSharedRef<FItemLibrary> Library = MakeShared<FItemLibrary>();
+	Library->Initialize(LibraryName, MoveTemp(Assets), Descriptions);
+	return Library;
+}
+
+bool FItemLibraryArchive::SaveDataTable(FName LibraryName, const UDataTable& DataTable, const FString& FilePath)
+{
+	FItemLibraryBuilder Builder;
+	if (!Builder.AddRows(DataTable))
+	{
+		UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Failed to build library %s. The data table %s must have FAwesomeAssetRow rows."), *LibraryName.ToString(), *DataTable.GetPathName())
+		return false;
+	}
+
+	// Never added to a manager, so it holds no loads and can go on any thread
+	FItemLibrary Library;
+	Library.Initialize(LibraryName, MoveTemp(Builder.Assets));
+	return Save(Library, FilePath);
+}
+
+bool FItemLibraryArchive::BuildCookedLibraries()
+{
+	const UAwesomeAssetLoaderSettings* Settings = GetDefault<UAwesomeAssetLoaderSettings>();
+	bool bSucceeded = true;
+	for (const FCookedItemLibrary& Cooked : Settings->CookedLibraries)
+	{
+		const UDataTable* DataTable = Cooked.DataTable.LoadSynchronous();
+		if (Cooked.LibraryName.IsNone() || !DataTable)
+		{
+			UE_LOG(FLogAwesomeAssetManager, Warning, TEXT("Cooked library %s has no name or its data table %s could not be loaded"), *Cooked.LibraryName.ToString(), *Cooked.DataTable.ToString())
+			bSucceeded = false;
+			continue;
+		}
+
+		const FString FilePath = Settings->GetLibraryFilePath(Cooked.LibraryName);
+		if (SaveDataTable(Cooked.LibraryName, *DataTable, FilePath))
+		{
+			UE_LOG(FLogAwesomeAssetManager, Display, TEXT("Built library %s into %s"), *Cooked.LibraryName.ToString(), *FilePath)
+		}
+		else
+		{
+			bSucceeded = false;
+		}
+	}
+	return bSucceeded;
+}
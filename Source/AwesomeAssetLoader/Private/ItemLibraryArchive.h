@@ -0,0 +1,80 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FItemLibrary;
+class UDataTable;
+
+/**
+ * Binary form of a built library, made at cook time or from the editor.
+ * Holds the description table exactly as it is laid out in memory next to a deduplicated string table of tags, unique Ids and paths.
+ * Loading maps the file and the table views its columns, sorted columns and masks in place instead of hashing, sorting and building,
+ * so processes that load the same file share its pages. Only the strings are converted.
+ */
+class FItemLibraryArchive
+{
+public:
+
+	/** Writes the library to a file. */
+	static bool Save(const FItemLibrary& Library, const FString& FilePath);
+
+	/** Reads a library from a file, or returns null if it is missing, from another version or names tags that no longer exist. */
+	static TSharedPtr<FItemLibrary> Load(FName LibraryName, const FString& FilePath);
+
+	/** Builds a library from a table of FAwesomeAssetRow rows on the calling thread and writes it to a file */
+	static bool SaveDataTable(FName LibraryName, const UDataTable& DataTable, const FString& FilePath);
+
+	/** Writes every library listed in UAwesomeAssetLoaderSettings to its file. Runs when cooking and from the BuildItemLibraries commandlet. */
+	static bool BuildCookedLibraries();
+
+private:
+
+	static constexpr uint32 Magic = 0x4C4D4141; // "AAML"
+	static constexpr uint32 Version = 1;
+
+	/** Every section starts at an offset from the start of the file that is a multiple of 8 */
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		int32 NumItems;
+		int32 NumTags;
+		int32 NumBits;
+		int32 MaskWords;
+		int32 NumStrings;
+		int32 NumItemPaths;
+
+		/** NumStrings + 1 uint32 offsets into the UTF-8 string data */
+		uint64 StringOffsetsOffset;
+		uint64 StringDataOffset;
+
+		/** NumBits int32 string indices of the tag of each dictionary bit. The first NumTags are the columns. */
+		uint64 TagBitsOffset;
+
+		/** NumItems * MaskWords uint64 */
+		uint64 MasksOffset;
+
+		/** NumTags columns of NumItems floats */
+		uint64 ColumnsOffset;
+
+		/** NumTags int32 entry counts, then the entries of every sorted column back to back */
+		uint64 SortedCountsOffset;
+		uint64 SortedEntriesOffset;
+
+		/** NumItems FItemRecord */
+		uint64 ItemsOffset;
+
+		/** NumItemPaths int32 string indices, in item order */
+		uint64 ItemPathsOffset;
+	};
+
+	struct FItemRecord
+	{
+		/** String index or INDEX_NONE for items without one */
+		int32 UniqueId;
+		int32 FirstPath;
+		int32 NumPaths;
+	};
+};
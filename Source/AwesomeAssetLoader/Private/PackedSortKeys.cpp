@@ -0,0 +1,241 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PackedSortKeys.h"
+#include "ItemLibrary.h"
+#include "ScratchPool.h"
+#include "Algo/Sort.h"
+#include "Algo/StableSort.h"
+
+namespace PackedSortKeys
+{
+	/** Where one key sits in an item's packed words */
+	struct FField
+	{
+		/** Column of the key, or INDEX_NONE for the base order */
+		int32 Column;
+		bool bDescending;
+		int32 Word;
+		int32 Shift;
+		uint64 Mask;
+	};
+
+	FORCEINLINE void SetField(uint64* Key, const FField& Field, const uint64 Value)
+	{
+		Key[Field.Word] = (Key[Field.Word] & ~(Field.Mask << Field.Shift)) | (Value << Field.Shift);
+	}
+
+	/** Stable LSD radix sort of Items by the single word keys in Scratch.RadixKeys[0], which are in the same order */
+	bool RadixSort(FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, TArray<int32>& Items)
+	{
+		const int32 Num = Items.Num();
+		if (Num < 2)
+		{
+			return true;
+		}
+		
+		// Reset rather than SetNum so the scratch keeps its capacity
+		Scratch.RadixKeys[1].Reset(Num);
+		Scratch.RadixKeys[1].AddUninitialized(Num);
+		Scratch.RadixItems.Reset(Num);
+		Scratch.RadixItems.AddUninitialized(Num);
+		uint64* Keys = Scratch.RadixKeys[0].GetData();
+		uint64* OtherKeys = Scratch.RadixKeys[1].GetData();
+		int32* SortItems = Items.GetData();
+		int32* OtherItems = Scratch.RadixItems.GetData();
+
+		// One pass per byte, skipping bytes that are the same for every key, like the low bits no field uses
+		for (int32 Shift = 0; Shift < 64; Shift += 8)
+		{
+			if (Cancellation.IsCancelled())
+			{
+				return false;
+			}
+			
+			int32 Counts[256] = {};
+			for (int32 i = 0; i < Num; ++i)
+			{
+				++Counts[(Keys[i] >> Shift) & 0xFF];
+			}
+			if (Counts[(Keys[0] >> Shift) & 0xFF] == Num)
+			{
+				continue;
+			}
+
+			int32 Offset = 0;
+			for (int32& Count : Counts)
+			{
+				const int32 BucketSize = Count;
+				Count = Offset;
+				Offset += BucketSize;
+			}
+
+			for (int32 i = 0; i < Num; ++i)
+			{
+				const int32 Destination = Counts[(Keys[i] >> Shift) & 0xFF]++;
+				OtherKeys[Destination] = Keys[i];
+				OtherItems[Destination] = SortItems[i];
+			}
+			Swap(Keys, OtherKeys);
+			Swap(SortItems, OtherItems);
+		}
+
+		if (SortItems != Items.GetData())
+		{
+			FMemory::Memcpy(Items.GetData(), SortItems, Num * sizeof(int32));
+		}
+		return true;
+	}
+}
+
+bool FPackedSortKeys::Sort(const FItemDescriptionTable& Descriptions, const FFilterAndSortCriterion& Criterion, const TArray<int32>& FilteredAssets, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, TArray<int32>& SortedAssets)
+{
+	using namespace PackedSortKeys;
+
+	// Fields are laid out from the top bits of the first word down, starting a new word when the next one does not fit
+	TArray<FField, TInlineAllocator<8>> Fields;
+	int32 NumWords = 0;
+	int32 FreeBits = 0;
+	const auto AddField = [&Fields, &NumWords, &FreeBits](const int32 Column, const bool bDescending, const int32 NumValues)
+	{
+		// Room for one more value than there can be ranks, so the largest is left for items that have none
+		const int32 Bits = FMath::Max(1, static_cast<int32>(FMath::CeilLogTwo(static_cast<uint32>(NumValues) + 1)));
+		if (Bits > FreeBits)
+		{
+			++NumWords;
+			FreeBits = 64;
+		}
+		FreeBits -= Bits;
+		Fields.Emplace(FField{ Column, bDescending, NumWords - 1, FreeBits, (1ull << Bits) - 1 });
+	};
+	for (const FAssetSortKey& SortKey : Criterion.SortKeys)
+	{
+		// A tag without a column is on no item so it can not order anything
+		const int32 Column = Descriptions.FindColumn(SortKey.Tag);
+		if (Column != INDEX_NONE)
+		{
+			AddField(Column, SortKey.bDescending, Descriptions.SortedColumns[Column].Num());
+		}
+	}
+	if (!Criterion.BaseOrder.IsEmpty())
+	{
+		AddField(INDEX_NONE, false, Criterion.BaseOrder.Num());
+	}
+
+	// Every field of a filtered item starts out as its largest value, which puts items without a value last
+	TArray<uint64>& PackedKeys = Scratch.PackedKeys;
+	PackedKeys.Reset(Descriptions.NumItems * NumWords);
+	PackedKeys.AddUninitialized(Descriptions.NumItems * NumWords);
+	for (const int32 ItemIndex : FilteredAssets)
+	{
+		for (int32 Word = 0; Word < NumWords; ++Word)
+		{
+			PackedKeys[ItemIndex * NumWords + Word] = MAX_uint64;
+		}
+	}
+
+	for (const FField& Field : Fields)
+	{
+		if (Cancellation.IsCancelled())
+		{
+			return false;
+		}
+		
+		if (Field.Column == INDEX_NONE)
+		{
+			// An Id listed more than once goes where it is listed first
+			TMap<FName, int32> BasePositions;
+			BasePositions.Reserve(Criterion.BaseOrder.Num());
+			for (int32 Position = 0; Position < Criterion.BaseOrder.Num(); ++Position)
+			{
+				BasePositions.FindOrAdd(Criterion.BaseOrder[Position], Position);
+			}
+			for (const int32 ItemIndex : FilteredAssets)
+			{
+				if (const int32* Position = BasePositions.Find(Descriptions.UniqueIds[ItemIndex]))
+				{
+					SetField(PackedKeys.GetData() + ItemIndex * NumWords, Field, *Position);
+				}
+			}
+			continue;
+		}
+
+		// Ranks count distinct values along the pre-sorted column in the key's direction, so equal values share one.
+		// Items that are not filtered are written too, which is cheaper than checking and never read.
+		const TTableArray<FColumnEntry>& Entries = Descriptions.SortedColumns[Field.Column];
+		uint64 Rank = 0;
+		uint32 PreviousValueKey = 0;
+		for (int32 i = 0; i < Entries.Num(); ++i)
+		{
+			const FColumnEntry& Entry = Entries[Field.bDescending ? Entries.Num() - 1 - i : i];
+			const uint32 ValueKey = FItemDescriptionTable::GetSortKey(Entry.Value);
+			if (i > 0 && ValueKey != PreviousValueKey)
+			{
+				++Rank;
+			}
+			PreviousValueKey = ValueKey;
+			SetField(PackedKeys.GetData() + Entry.ItemIndex * NumWords, Field, Rank);
+		}
+	}
+
+	if (Cancellation.IsCancelled())
+	{
+		return false;
+	}
+
+	SortedAssets = FilteredAssets;
+	if (NumWords == 1)
+	{
+		TArray<uint64>& Keys = Scratch.RadixKeys[0];
+		Keys.Reset(FilteredAssets.Num());
+		for (const int32 ItemIndex : FilteredAssets)
+		{
+			Keys.Emplace(PackedKeys[ItemIndex]);
+		}
+		if (!RadixSort(Scratch, Cancellation, SortedAssets))
+		{
+			return false;
+		}
+	}
+	else if (NumWords > 1)
+	{
+		// Keys too wide for one word compare word by word, then by item so ties come out in item order as from the radix sort
+		const uint64* Keys = PackedKeys.GetData();
+		Algo::Sort(SortedAssets, [Keys, NumWords](const int32 ItemA, const int32 ItemB)
+		{
+			const uint64* KeyA = Keys + ItemA * NumWords;
+			const uint64* KeyB = Keys + ItemB * NumWords;
+			for (int32 Word = 0; Word < NumWords; ++Word)
+			{
+				if (KeyA[Word] != KeyB[Word])
+				{
+					return KeyA[Word] < KeyB[Word];
+				}
+			}
+			return ItemA < ItemB;
+		});
+	}
+
+	// Runs that tie on every key go by unique Id. Runs are in item order so items with the same Id stay in item order.
+	const auto SameKeys = [&PackedKeys, NumWords](const int32 ItemA, const int32 ItemB)
+	{
+		return NumWords == 0 || FMemory::Memcmp(PackedKeys.GetData() + ItemA * NumWords, PackedKeys.GetData() + ItemB * NumWords, NumWords * sizeof(uint64)) == 0;
+	};
+	const auto IdLess = [&Descriptions](const int32 ItemA, const int32 ItemB)
+	{
+		return Descriptions.UniqueIds[ItemA].Compare(Descriptions.UniqueIds[ItemB]) < 0;
+	};
+	for (int32 Start = 0; Start < SortedAssets.Num();)
+	{
+		int32 End = Start + 1;
+		while (End < SortedAssets.Num() && SameKeys(SortedAssets[Start], SortedAssets[End]))
+		{
+			++End;
+		}
+		if (End - Start > 1)
+		{
+			Algo::StableSort(MakeArrayView(SortedAssets.GetData() + Start, End - Start), IdLess);
+		}
+		Start = End;
+	}
+	return true;
+}
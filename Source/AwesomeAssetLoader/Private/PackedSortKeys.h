@@ -0,0 +1,20 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FItemDescriptionTable;
+struct FFilterAndSortCriterion;
+struct FFilterAndSortScratch;
+struct FSortCancellation;
+
+/**
+ * Sorts by a criterion's SortKeys and BaseOrder with every item's keys packed into fixed width integers once per sort, so sorting only compares integers.
+ * A key is packed as the rank of the item's value among the distinct values of its column, so a few keys usually fit in a single 64 bit word.
+ */
+struct FPackedSortKeys
+{
+	/** Replaces SortedAssets with the filtered items in order. Items that tie on every key go by unique Id. Returns false if cancelled part way. */
+	static bool Sort(const FItemDescriptionTable& Descriptions, const FFilterAndSortCriterion& Criterion, const TArray<int32>& FilteredAssets, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, TArray<int32>& SortedAssets);
+};
@@ -0,0 +1,104 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathRegistry.h"
+
+
+FPathRegistry::FPathRequest::~FPathRequest()
+{
+	if (Handle.IsValid())
+	{
+		Handle->IsLoadingInProgress() ? Handle->CancelHandle() : Handle->ReleaseHandle();
+	}
+}
+
+void FPathRegistry::Acquire(TConstArrayView<FSoftObjectPath> Paths, const TAsyncLoadPriority Priority, FRequestPaths& OutToRequest, FWaitRequests& OutWaitOn)
+{
+	check(IsInGameThread());
+	for (const FSoftObjectPath& Path : Paths)
+	{
+		++Entries.FindOrAdd(Path).RefCount;
+	}
+	Gather(Paths, Priority, OutToRequest, OutWaitOn);
+}
+
+void FPathRegistry::Release(TConstArrayView<FSoftObjectPath> Paths)
+{
+	check(IsInGameThread());
+	for (const FSoftObjectPath& Path : Paths)
+	{
+		FPathEntry* Entry = Entries.Find(Path);
+		if (ensure(Entry) && --Entry->RefCount == 0)
+		{
+			Entries.Remove(Path);
+		}
+	}
+}
+
+void FPathRegistry::Gather(TConstArrayView<FSoftObjectPath> Paths, const TAsyncLoadPriority Priority, FRequestPaths& OutToRequest, FWaitRequests& OutWaitOn) const
+{
+	for (const FSoftObjectPath& Path : Paths)
+	{
+		const FPathEntry* Entry = Entries.Find(Path);
+		if (Entry && Entry->IsLoaded())
+		{
+			continue;
+		}
+		
+		if (Entry && Entry->Request.IsValid() && Entry->Request->Priority >= Priority)
+		{
+			OutWaitOn.AddUnique(Entry->Request.ToSharedRef());
+		}
+		else
+		{
+			OutToRequest.Emplace(Path);
+		}
+	}
+}
+
+TSharedRef<FPathRegistry::FPathRequest> FPathRegistry::Request(const TArray<FSoftObjectPath>& Paths, const TAsyncLoadPriority Priority, FStreamableManager& StreamableManager)
+{
+	check(IsInGameThread());
+	const TSharedRef<FPathRequest> Request = MakeShared<FPathRequest>();
+	Request->Priority = Priority;
+	Request->Handle = StreamableManager.RequestAsyncLoad(Paths, FStreamableDelegate::CreateLambda([WeakRequest = TWeakPtr<FPathRequest>(Request)]()
+	{
+		if (const TSharedPtr<FPathRequest> Completed = WeakRequest.Pin())
+		{
+			Completed->OnCompleted.Broadcast();
+		}
+	}), Priority);
+	
+	for (const FSoftObjectPath& Path : Paths)
+	{
+		if (FPathEntry* Entry = Entries.Find(Path); ensure(Entry))
+		{
+			// The new request takes over from any older one still loading the path. The older one stays while a batch waits on it.
+			Entry->Request = Request;
+		}
+	}
+	return Request;
+}
+
+bool FPathRegistry::AreLoaded(TConstArrayView<FSoftObjectPath> Paths) const
+{
+	for (const FSoftObjectPath& Path : Paths)
+	{
+		const FPathEntry* Entry = Entries.Find(Path);
+		if (!Entry || !Entry->IsLoaded())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FPathRegistry::GetNumLoadedPaths() const
+{
+	int32 NumLoaded = 0;
+	for (const TPair<FSoftObjectPath, FPathEntry>& Entry : Entries)
+	{
+		NumLoaded += Entry.Value.IsLoaded() ? 1 : 0;
+	}
+	return NumLoaded;
+}
@@ -0,0 +1,78 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/StreamableManager.h"
+
+/**
+ * Reference counts every soft path held by the items of all of a manager's libraries, so each unique path is only
+ * requested once no matter how many items depend on it. Game thread only.
+ */
+class FPathRegistry
+{
+public:
+
+	/** A streamable request shared by the paths it was issued for. Stops or lets go of the load once nothing uses it. */
+	struct FPathRequest
+	{
+		~FPathRequest();
+
+		/** Null if there was nothing to load */
+		TSharedPtr<FStreamableHandle> Handle;
+
+		/** Priority the paths were requested at. A path in flight is only requested again to raise it above this. */
+		TAsyncLoadPriority Priority = FStreamableManager::DefaultAsyncLoadPriority;
+
+		/** Broadcast once the load completes, for every batch waiting on it */
+		FSimpleMulticastDelegate OnCompleted;
+	};
+
+	/** Paths gathered for one request. Most requests fit inline so gathering them does not allocate. */
+	using FRequestPaths = TSet<FSoftObjectPath, DefaultKeyFuncs<FSoftObjectPath>, TInlineSetAllocator<64>>;
+
+	/** Requests already in flight that a batch waits on in place of requesting their paths again */
+	using FWaitRequests = TArray<TSharedRef<FPathRequest>, TInlineAllocator<8>>;
+
+	/** Adds a reference to each path, then gathers them like Gather */
+	void Acquire(TConstArrayView<FSoftObjectPath> Paths, const TAsyncLoadPriority Priority, FRequestPaths& OutToRequest, FWaitRequests& OutWaitOn);
+
+	/** Removes a reference from each path. Paths nobody references any more stop being kept alive. */
+	void Release(TConstArrayView<FSoftObjectPath> Paths);
+
+	/**
+	 * Adds the paths that have not finished loading to OutToRequest, unless a request already in flight loads them at the priority or higher.
+	 * Those requests go to OutWaitOn instead, so a path shared by many items is only requested again to promote it.
+	 */
+	void Gather(TConstArrayView<FSoftObjectPath> Paths, const TAsyncLoadPriority Priority, FRequestPaths& OutToRequest, FWaitRequests& OutWaitOn) const;
+
+	/** Requests the paths and makes the request the one that loads them. They must all be referenced. */
+	TSharedRef<FPathRequest> Request(const TArray<FSoftObjectPath>& Paths, const TAsyncLoadPriority Priority, FStreamableManager& StreamableManager);
+
+	/** Have all the paths finished loading */
+	bool AreLoaded(TConstArrayView<FSoftObjectPath> Paths) const;
+
+	/** Number of unique paths referenced */
+	FORCEINLINE int32 GetNumPaths() const { return Entries.Num(); }
+
+	/** Number of unique paths referenced that have finished loading */
+	int32 GetNumLoadedPaths() const;
+
+private:
+
+	struct FPathEntry
+	{
+		int32 RefCount = 0;
+
+		/** The latest request for the path. Null until requested. */
+		TSharedPtr<FPathRequest> Request;
+
+		/** A request that came back without a handle had nothing to load */
+		FORCEINLINE bool IsLoaded() const
+		{
+			return Request.IsValid() && (!Request->Handle.IsValid() || Request->Handle->HasLoadCompleted());
+		}
+	};
+
+	TMap<FSoftObjectPath, FPathEntry> Entries;
+};
@@ -0,0 +1,354 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "QueryPlan.h"
+#include "Async/ParallelFor.h"
+#include "Algo/Compare.h"
+
+
+TSharedRef<const FQueryPlan> FQueryPlan::Compile(const FItemDescriptionTable& Descriptions, const FAssetQuery& Query)
+{
+	const TSharedRef<FQueryPlan> Plan = MakeShared<FQueryPlan>();
+	Plan->Query = Query;
+	Plan->Hash = GetTypeHash(Query);
+	Plan->MaskWords = Descriptions.MaskWords;
+
+	// Each top level term becomes a clause of its own so narrowing a query can reuse what matched before
+	int32 TermIndex = 0;
+	while (TermIndex < Query.Terms.Num())
+	{
+		FClause Clause;
+		Clause.FirstInstruction = Plan->Instructions.Num();
+		int32 Depth = 0;
+		const int32 NextTerm = Plan->CompileTerm(Descriptions, TermIndex, Depth);
+		Clause.NumInstructions = Plan->Instructions.Num() - Clause.FirstInstruction;
+		Clause.FirstTerm = TermIndex;
+		Clause.NumTerms = NextTerm - TermIndex;
+		Clause.Hash = GetTypeHash(NextTerm - TermIndex);
+		for (int32 Term = TermIndex; Term < NextTerm; ++Term)
+		{
+			Clause.Hash = HashCombineFast(Clause.Hash, GetTypeHash(Query.Terms[Term]));
+		}
+		Plan->AllClauses.Emplace(Plan->Clauses.Emplace(Clause));
+		TermIndex = NextTerm;
+	}
+	return Plan;
+}
+
+int32 FQueryPlan::CompileTerm(const FItemDescriptionTable& Descriptions, const int32 TermIndex, int32& Depth)
+{
+	const TArray<FAssetQueryTerm>& Terms = Query.Terms;
+	const FAssetQueryTerm& Term = Terms[TermIndex];
+	TArray<uint64, TInlineAllocator<4>> Mask;
+	Mask.SetNumZeroed(MaskWords);
+
+	switch (Term.Type)
+	{
+	case EAssetQueryTermType::HasTag:
+		{
+			// A tag no item has gives an empty mask, which no item has any of
+			const int32 Bit = Descriptions.FindBit(Term.Tag);
+			if (Bit != INDEX_NONE)
+			{
+				Mask[Bit >> 6] |= 1ull << (Bit & 63);
+			}
+			EmitMask(EOp::HasAny, Mask, Depth);
+			return TermIndex + 1;
+		}
+
+	case EAssetQueryTermType::ValueInRange:
+		{
+			const int32 Column = Descriptions.FindColumn(Term.Tag);
+			if (Column == INDEX_NONE)
+			{
+				EmitMask(EOp::HasAny, Mask, Depth);
+			}
+			else
+			{
+				Instructions.Emplace(FInstruction{ EOp::InRange, Column, Term.Min, Term.Max });
+				MaxDepth = FMath::Max(MaxDepth, ++Depth);
+			}
+			return TermIndex + 1;
+		}
+
+	default:
+		break;
+	}
+
+	// Groups test all of their tag children with a single mask and combine that with the rest of their children
+	const bool bAllOf = Term.Type == EAssetQueryTermType::AllOf;
+	bool bUnknownTag = false;
+	int32 NumOperands = 0;
+	int32 NextTerm = TermIndex + 1;
+	for (int32 Child = 0; Child < Term.NumChildren && NextTerm < Terms.Num(); ++Child)
+	{
+		if (Terms[NextTerm].Type == EAssetQueryTermType::HasTag)
+		{
+			const int32 Bit = Descriptions.FindBit(Terms[NextTerm].Tag);
+			if (Bit != INDEX_NONE)
+			{
+				Mask[Bit >> 6] |= 1ull << (Bit & 63);
+			}
+			bUnknownTag |= Bit == INDEX_NONE;
+			++NextTerm;
+		}
+		else
+		{
+			NextTerm = CompileTerm(Descriptions, NextTerm, Depth);
+			++NumOperands;
+		}
+	}
+
+	bool bHasMaskBits = false;
+	for (const uint64 Word : Mask)
+	{
+		bHasMaskBits |= Word != 0;
+	}
+
+	if (bAllOf && bUnknownTag)
+	{
+		// Nothing has all of the tags when one of them is unknown
+		Mask.Init(0, MaskWords);
+		EmitMask(EOp::HasAny, Mask, Depth);
+		++NumOperands;
+	}
+	else if (bHasMaskBits || NumOperands == 0)
+	{
+		// An empty AllOf matches everything and an empty AnyOf nothing
+		EmitMask(bAllOf ? EOp::HasAll : EOp::HasAny, Mask, Depth);
+		++NumOperands;
+	}
+
+	EmitCombine(bAllOf ? EOp::And : EOp::Or, NumOperands, Depth);
+	if (Term.Type == EAssetQueryTermType::NoneOf)
+	{
+		Instructions.Emplace(FInstruction{ EOp::Not, 0, 0.f, 0.f });
+	}
+	return NextTerm;
+}
+
+void FQueryPlan::EmitMask(const EOp Op, const TArray<uint64, TInlineAllocator<4>>& Mask, int32& Depth)
+{
+	Instructions.Emplace(FInstruction{ Op, Masks.Num(), 0.f, 0.f });
+	Masks.Append(Mask);
+	MaxDepth = FMath::Max(MaxDepth, ++Depth);
+}
+
+void FQueryPlan::EmitCombine(const EOp Op, const int32 NumOperands, int32& Depth)
+{
+	if (NumOperands > 1)
+	{
+		Instructions.Emplace(FInstruction{ Op, NumOperands, 0.f, 0.f });
+		Depth -= NumOperands - 1;
+	}
+}
+
+uint64 FQueryPlan::EvaluateClause(const FItemDescriptionTable& Descriptions, const FClause& Clause, const int32* Items, const int32 NumBlockItems) const
+{
+	TArray<uint64, TInlineAllocator<16>> Stack;
+	Stack.Reserve(MaxDepth);
+
+	for (int32 Instruction = Clause.FirstInstruction; Instruction < Clause.FirstInstruction + Clause.NumInstructions; ++Instruction)
+	{
+		const FInstruction& Current = Instructions[Instruction];
+		uint64 Bits = 0;
+		switch (Current.Op)
+		{
+		case EOp::HasAll:
+		case EOp::HasAny:
+			{
+				const uint64* Mask = Masks.GetData() + Current.Operand;
+				const bool bAll = Current.Op == EOp::HasAll;
+				for (int32 i = 0; i < NumBlockItems; ++i)
+				{
+					const uint64* ItemMask = Descriptions.GetMask(Items[i]);
+					uint64 Missing = 0;
+					uint64 Present = 0;
+					for (int32 Word = 0; Word < MaskWords; ++Word)
+					{
+						Missing |= ~ItemMask[Word] & Mask[Word];
+						Present |= ItemMask[Word] & Mask[Word];
+					}
+					Bits |= static_cast<uint64>(bAll ? Missing == 0 : Present != 0) << i;
+				}
+				Stack.Emplace(Bits);
+				break;
+			}
+
+		case EOp::InRange:
+			{
+				const float* Values = Descriptions.Columns[Current.Operand].GetData();
+				for (int32 i = 0; i < NumBlockItems; ++i)
+				{
+					const float Value = Values[Items[i]];
+					Bits |= static_cast<uint64>(Descriptions.HasColumn(Items[i], Current.Operand) & (Value >= Current.Min) & (Value <= Current.Max)) << i;
+				}
+				Stack.Emplace(Bits);
+				break;
+			}
+
+		case EOp::And:
+			{
+				Bits = ~0ull;
+				for (int32 Operand = 0; Operand < Current.Operand; ++Operand)
+				{
+					Bits &= Stack.Pop(EAllowShrinking::No);
+				}
+				Stack.Emplace(Bits);
+				break;
+			}
+
+		case EOp::Or:
+			{
+				for (int32 Operand = 0; Operand < Current.Operand; ++Operand)
+				{
+					Bits |= Stack.Pop(EAllowShrinking::No);
+				}
+				Stack.Emplace(Bits);
+				break;
+			}
+
+		case EOp::Not:
+			Stack.Last() = ~Stack.Last();
+			break;
+		}
+	}
+
+	// Bits past the end of the block are not items
+	const uint64 BlockMask = NumBlockItems == 64 ? ~0ull : (1ull << NumBlockItems) - 1;
+	return Stack.Last() & BlockMask;
+}
+
+int32 FQueryPlan::RefineRange(const FItemDescriptionTable& Descriptions, TConstArrayView<int32> ClauseIndices, int32* Items, const int32 NumItems) const
+{
+	// Kept items never move past the block being read, so the range is compacted in place
+	int32 NumKept = 0;
+	for (int32 BlockStart = 0; BlockStart < NumItems; BlockStart += 64)
+	{
+		const int32 NumBlockItems = FMath::Min(64, NumItems - BlockStart);
+		uint64 Passed = ~0ull;
+		for (int32 ClauseIndex = 0; ClauseIndex < ClauseIndices.Num() && Passed != 0; ++ClauseIndex)
+		{
+			Passed &= EvaluateClause(Descriptions, Clauses[ClauseIndices[ClauseIndex]], Items + BlockStart, NumBlockItems);
+		}
+		Passed &= NumBlockItems == 64 ? ~0ull : (1ull << NumBlockItems) - 1;
+
+		while (Passed)
+		{
+			Items[NumKept++] = Items[BlockStart + FMath::CountTrailingZeros64(Passed)];
+			Passed &= Passed - 1;
+		}
+	}
+	return NumKept;
+}
+
+void FQueryPlan::Refine(const FItemDescriptionTable& Descriptions, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation) const
+{
+	RefineByClauses(Descriptions, AllClauses, InOutPassed, Cancellation);
+}
+
+void FQueryPlan::RefineByClauses(const FItemDescriptionTable& Descriptions, TConstArrayView<int32> ClauseIndices, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation) const
+{
+	// Refined in slices so that cancellation is checked between them
+	const int32 SliceSize = Cancellation ? FSortCancellation::CheckInterval : FMath::Max(1, InOutPassed.Num());
+	int32 NumPassed = 0;
+	for (int32 Start = 0; Start < InOutPassed.Num(); Start += SliceSize)
+	{
+		if (Cancellation && Cancellation->IsCancelled())
+		{
+			break;
+		}
+		const int32 NumKept = RefineRange(Descriptions, ClauseIndices, InOutPassed.GetData() + Start, FMath::Min(SliceSize, InOutPassed.Num() - Start));
+		FMemory::Memmove(InOutPassed.GetData() + NumPassed, InOutPassed.GetData() + Start, NumKept * sizeof(int32));
+		NumPassed += NumKept;
+	}
+	InOutPassed.SetNum(NumPassed, EAllowShrinking::No);
+}
+
+void FQueryPlan::RefineParallel(const FItemDescriptionTable& Descriptions, const int32 ChunkSize, FFilterAndSortScratch& Scratch, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation) const
+{
+	// Each chunk compacts itself in place, then the chunks are moved together
+	const int32 NumChunks = FMath::DivideAndRoundUp(InOutPassed.Num(), ChunkSize);
+	TArray<int32>& NumKept = Scratch.ChunkStarts;
+	NumKept.SetNumUninitialized(NumChunks, EAllowShrinking::No);
+	ParallelFor(NumChunks, [this, &Descriptions, ChunkSize, &InOutPassed, &NumKept, Cancellation](const int32 Chunk)
+	{
+		const int32 Start = Chunk * ChunkSize;
+		const int32 End = FMath::Min(Start + ChunkSize, InOutPassed.Num());
+		NumKept[Chunk] = Cancellation && Cancellation->IsCancelled() ? 0 : RefineRange(Descriptions, AllClauses, InOutPassed.GetData() + Start, End - Start);
+	});
+
+	int32 NumPassed = 0;
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		FMemory::Memmove(InOutPassed.GetData() + NumPassed, InOutPassed.GetData() + Chunk * ChunkSize, NumKept[Chunk] * sizeof(int32));
+		NumPassed += NumKept[Chunk];
+	}
+	InOutPassed.SetNum(NumPassed, EAllowShrinking::No);
+}
+
+bool FQueryPlan::Passes(const FItemDescriptionTable& Descriptions, const int32 ItemIndex) const
+{
+	int32 Item = ItemIndex;
+	return RefineRange(Descriptions, AllClauses, &Item, 1) == 1;
+}
+
+bool FQueryPlan::GetAddedClauses(const FQueryPlan& Other, TArray<int32>& OutAdded) const
+{
+	// Every clause of Other has to be in this plan. A clause of this plan can only stand in for one of Other's.
+	// Hashes only rule clauses out, so ones with the same hash also have their terms compared.
+	TBitArray<TInlineAllocator<4>> Matched(false, Clauses.Num());
+	for (const FClause& OtherClause : Other.Clauses)
+	{
+		const TConstArrayView<FAssetQueryTerm> OtherTerms = Other.GetTerms(OtherClause);
+		const int32 Found = Clauses.IndexOfByPredicate([&Matched, &OtherClause, &OtherTerms, this](const FClause& Clause)
+		{
+			return Clause.Hash == OtherClause.Hash && !Matched[static_cast<int32>(&Clause - Clauses.GetData())] && Algo::Compare(GetTerms(Clause), OtherTerms);
+		});
+		if (Found == INDEX_NONE)
+		{
+			return false;
+		}
+		Matched[Found] = true;
+	}
+
+	OutAdded.Reset();
+	for (int32 ClauseIndex = 0; ClauseIndex < Clauses.Num(); ++ClauseIndex)
+	{
+		if (!Matched[ClauseIndex])
+		{
+			OutAdded.Emplace(ClauseIndex);
+		}
+	}
+	return true;
+}
+
+TSharedRef<const FQueryPlan> FQueryPlanCache::FindOrCompile(const FItemDescriptionTable& Descriptions, const FAssetQuery& Query)
+{
+	const uint32 Hash = GetTypeHash(Query);
+	{
+		FScopeLock ScopeLock(&Lock);
+		const int32 Found = Plans.IndexOfByPredicate([Hash, &Query](const TSharedRef<const FQueryPlan>& Plan)
+		{
+			return Plan->GetHash() == Hash && Plan->GetQuery() == Query;
+		});
+		if (Found != INDEX_NONE)
+		{
+			const TSharedRef<const FQueryPlan> Plan = Plans[Found];
+			Plans.RemoveAt(Found, 1, EAllowShrinking::No);
+			Plans.Emplace(Plan);
+			return Plan;
+		}
+	}
+
+	// Compiled outside of the lock. Two tasks compiling the same query both keep a valid plan.
+	const TSharedRef<const FQueryPlan> Plan = FQueryPlan::Compile(Descriptions, Query);
+
+	FScopeLock ScopeLock(&Lock);
+	if (Plans.Num() >= MaxPlans)
+	{
+		Plans.RemoveAt(0, 1, EAllowShrinking::No);
+	}
+	Plans.Emplace(Plan);
+	return Plan;
+}
@@ -0,0 +1,133 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemLibrary.h"
+
+/**
+ * An FAssetQuery compiled against a library's tag dictionary into flat postfix programs, one clause per top level term.
+ * Items are evaluated 64 at a time with every instruction producing one bit per item, so a block is one pass over the program without branching per item.
+ */
+class FQueryPlan
+{
+public:
+
+	/** Compiles the query. Terms on tags the library does not know never match. */
+	static TSharedRef<const FQueryPlan> Compile(const FItemDescriptionTable& Descriptions, const FAssetQuery& Query);
+
+	/** Keeps the items of InOutPassed that match every clause, in the same order. Stops part way if cancelled. */
+	void Refine(const FItemDescriptionTable& Descriptions, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation = nullptr) const;
+
+	/** Same as Refine but splits the items into chunks of ChunkSize that are refined across worker threads */
+	void RefineParallel(const FItemDescriptionTable& Descriptions, const int32 ChunkSize, FFilterAndSortScratch& Scratch, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation = nullptr) const;
+
+	/** Keeps the items of InOutPassed that match the given clauses only */
+	void RefineByClauses(const FItemDescriptionTable& Descriptions, TConstArrayView<int32> ClauseIndices, TArray<int32>& InOutPassed, const FSortCancellation* Cancellation = nullptr) const;
+
+	/** Does a single item match every clause */
+	bool Passes(const FItemDescriptionTable& Descriptions, const int32 ItemIndex) const;
+
+	/**
+	 * Finds whether this plan is Other with clauses added, as when a filter is narrowed down.
+	 * Items that matched Other then only have to be checked against the added clauses.
+	 */
+	bool GetAddedClauses(const FQueryPlan& Other, TArray<int32>& OutAdded) const;
+
+	FORCEINLINE const FAssetQuery& GetQuery() const { return Query; }
+	FORCEINLINE uint32 GetHash() const { return Hash; }
+
+private:
+
+	enum class EOp : uint8
+	{
+		/** Pushes whether the item has every bit of the mask at Operand in Masks */
+		HasAll,
+		/** Pushes whether the item has any bit of the mask at Operand in Masks */
+		HasAny,
+		/** Pushes whether the item has a value in column Operand between Min and Max */
+		InRange,
+		/** Pops Operand values and pushes whether they are all set */
+		And,
+		/** Pops Operand values and pushes whether any is set */
+		Or,
+		/** Inverts the top value */
+		Not
+	};
+
+	struct FInstruction
+	{
+		EOp Op;
+		int32 Operand;
+		float Min;
+		float Max;
+	};
+
+	struct FClause
+	{
+		int32 FirstInstruction;
+		int32 NumInstructions;
+
+		/** The query terms the clause was compiled from, which do not depend on the dictionary */
+		int32 FirstTerm;
+		int32 NumTerms;
+
+		/** Hash of the clause's terms */
+		uint32 Hash;
+	};
+
+	FORCEINLINE TConstArrayView<FAssetQueryTerm> GetTerms(const FClause& Clause) const
+	{
+		return MakeArrayView(Query.Terms).Slice(Clause.FirstTerm, Clause.NumTerms);
+	}
+
+	FAssetQuery Query;
+	uint32 Hash = 0;
+
+	TArray<FInstruction> Instructions;
+	TArray<FClause> Clauses;
+
+	/** Masks of the HasAll and HasAny instructions, MaskWords each */
+	TArray<uint64> Masks;
+	int32 MaskWords = 1;
+
+	/** Most values on the stack at once */
+	int32 MaxDepth = 0;
+
+	/** Compiles the term at TermIndex and its children. Returns the index of the term after them. */
+	int32 CompileTerm(const FItemDescriptionTable& Descriptions, const int32 TermIndex, int32& Depth);
+
+	void EmitMask(const EOp Op, const TArray<uint64, TInlineAllocator<4>>& Mask, int32& Depth);
+	void EmitCombine(const EOp Op, const int32 NumOperands, int32& Depth);
+
+	/** Bit i is set if Items[i] matches the clause, for up to 64 items */
+	uint64 EvaluateClause(const FItemDescriptionTable& Descriptions, const FClause& Clause, const int32* Items, const int32 NumBlockItems) const;
+
+	/** Moves the items that match the clauses to the front of the range and returns how many there are */
+	int32 RefineRange(const FItemDescriptionTable& Descriptions, TConstArrayView<int32> ClauseIndices, int32* Items, const int32 NumItems) const;
+
+	/** Every clause index, for refining by all of them */
+	TArray<int32> AllClauses;
+};
+
+/**
+ * Compiled plans of one library, found by query hash. Shared with sorting tasks so it is thread safe.
+ * A plan is only valid for the tag dictionary it was compiled against, so the cache is replaced whenever the library's dictionary changes.
+ */
+class FQueryPlanCache
+{
+public:
+
+	/** Returns the plan of the query, compiling it if it is not cached */
+	TSharedRef<const FQueryPlan> FindOrCompile(const FItemDescriptionTable& Descriptions, const FAssetQuery& Query);
+
+private:
+
+	/** Plans kept at once. The least recently used is dropped first. */
+	static constexpr int32 MaxPlans = 32;
+
+	FCriticalSection Lock;
+
+	/** Most recently used last */
+	TArray<TSharedRef<const FQueryPlan>> Plans;
+};
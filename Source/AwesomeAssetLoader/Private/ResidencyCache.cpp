@@ -0,0 +1,75 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ResidencyCache.h"
+#include "ItemLibrary.h"
+
+
+void FResidencyCache::SetBudget(const int64 NewBudgetBytes)
+{
+	BudgetBytes = FMath::Max<int64>(NewBudgetBytes, 0);
+	EvictToBudget();
+}
+
+bool FResidencyCache::Park(FItemLibrary* Library, const int32 ItemIndex, const int64 SizeBytes)
+{
+	check(IsInGameThread());
+
+	// Every item costs something so that a budget of 0 parks nothing
+	const int64 Cost = FMath::Max<int64>(SizeBytes, 1);
+	if (Cost > BudgetBytes)
+	{
+		return false;
+	}
+
+	const FResidentKey Key(Library, ItemIndex);
+	checkSlow(!Nodes.Contains(Key));
+	LeastRecentlyUsed.AddTail(FResidentItem{ Library, ItemIndex, Cost });
+	Nodes.Emplace(Key, LeastRecentlyUsed.GetTail());
+	ResidentBytes += Cost;
+	EvictToBudget();
+	return true;
+}
+
+void FResidencyCache::Revive(const FItemLibrary* Library, const int32 ItemIndex)
+{
+	check(IsInGameThread());
+	FResidentList::TDoubleLinkedListNode* Node = nullptr;
+	if (Nodes.RemoveAndCopyValue(FResidentKey(Library, ItemIndex), Node))
+	{
+		ResidentBytes -= Node->GetValue().SizeBytes;
+		LeastRecentlyUsed.RemoveNode(Node);
+	}
+}
+
+void FResidencyCache::RemoveLibrary(const FItemLibrary* Library)
+{
+	FResidentList::TDoubleLinkedListNode* Node = LeastRecentlyUsed.GetHead();
+	while (Node)
+	{
+		FResidentList::TDoubleLinkedListNode* Next = Node->GetNextNode();
+		const FResidentItem& Item = Node->GetValue();
+		if (Item.Library == Library)
+		{
+			Nodes.Remove(FResidentKey(Item.Library, Item.ItemIndex));
+			ResidentBytes -= Item.SizeBytes;
+			LeastRecentlyUsed.RemoveNode(Node);
+		}
+		Node = Next;
+	}
+}
+
+void FResidencyCache::EvictToBudget()
+{
+	while (ResidentBytes > BudgetBytes)
+	{
+		FResidentList::TDoubleLinkedListNode* Oldest = LeastRecentlyUsed.GetHead();
+		check(Oldest);
+		const FResidentItem Item = Oldest->GetValue();
+		Nodes.Remove(FResidentKey(Item.Library, Item.ItemIndex));
+		ResidentBytes -= Item.SizeBytes;
+		LeastRecentlyUsed.RemoveNode(Oldest);
+		
+		Item.Library->ReleaseResident(Item.ItemIndex);
+	}
+}
@@ -0,0 +1,61 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+
+class FItemLibrary;
+
+/**
+ * Keeps the loaded assets of items that left their library's buffer resident, least recently used first out.
+ * Shared by every library of a manager so that one byte budget covers them all. Game thread only.
+ */
+class FResidencyCache
+{
+public:
+
+	/** Parked handles are evicted once their estimated size goes over this. 0 parks nothing. */
+	void SetBudget(const int64 NewBudgetBytes);
+
+	FORCEINLINE int64 GetBudget() const { return BudgetBytes; }
+
+	/** Estimated size of everything parked */
+	FORCEINLINE int64 GetResidentBytes() const { return ResidentBytes; }
+
+	/**
+	 * Parks the item as the most recently used, evicting the least recently used if over budget.
+	 * @return False if the item could not be parked, in which case the caller releases its handle.
+	 */
+	bool Park(FItemLibrary* Library, const int32 ItemIndex, const int64 SizeBytes);
+
+	/** Takes the item out of the cache without releasing its handle */
+	void Revive(const FItemLibrary* Library, const int32 ItemIndex);
+
+	/** Forgets every item of a library without calling back into it */
+	void RemoveLibrary(const FItemLibrary* Library);
+
+private:
+
+	struct FResidentItem
+	{
+		FItemLibrary* Library;
+		int32 ItemIndex;
+		int64 SizeBytes;
+	};
+
+	using FResidentList = TDoubleLinkedList<FResidentItem>;
+	using FResidentKey = TPair<const FItemLibrary*, int32>;
+
+	/** Releases the least recently used items until within budget */
+	void EvictToBudget();
+
+	/** Least recently used at the head */
+	FResidentList LeastRecentlyUsed;
+
+	/** Finds an item's node in the list */
+	TMap<FResidentKey, FResidentList::TDoubleLinkedListNode*> Nodes;
+
+	int64 BudgetBytes = 256 * 1024 * 1024;
+	int64 ResidentBytes = 0;
+};
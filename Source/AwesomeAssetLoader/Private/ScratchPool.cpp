@@ -0,0 +1,63 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ScratchPool.h"
+
+LLM_DEFINE_TAG(AwesomeAssetLoader);
+
+
+SIZE_T FFilterAndSortScratch::GetAllocatedSize() const
+{
+	SIZE_T Size = FilteredBits.GetAllocatedSize() + Chunks.GetAllocatedSize() + ChunkStarts.GetAllocatedSize()
+		+ PackedKeys.GetAllocatedSize() + RadixKeys[0].GetAllocatedSize() + RadixKeys[1].GetAllocatedSize() + RadixItems.GetAllocatedSize();
+	for (const TArray<int32>& Chunk : Chunks)
+	{
+		Size += Chunk.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FScratchPool::FScope::FScope()
+	: Scratch(Get().Acquire())
+{
+	StartSize = Scratch->GetAllocatedSize();
+}
+
+FScratchPool::FScope::~FScope()
+{
+	Get().Release(MoveTemp(Scratch), StartSize);
+}
+
+FScratchPool& FScratchPool::Get()
+{
+	static FScratchPool Pool;
+	return Pool;
+}
+
+TUniquePtr<FFilterAndSortScratch> FScratchPool::Acquire()
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (!Free.IsEmpty())
+		{
+			return Free.Pop(EAllowShrinking::No);
+		}
+	}
+	
+	LLM_SCOPE_BYTAG(AwesomeAssetLoader);
+	return MakeUnique<FFilterAndSortScratch>();
+}
+
+void FScratchPool::Release(TUniquePtr<FFilterAndSortScratch>&& Scratch, const SIZE_T StartSize)
+{
+	// Buffers only grow, so any growth while held means at least one allocation
+	const SIZE_T EndSize = Scratch->GetAllocatedSize();
+	if (EndSize != StartSize)
+	{
+		NumGrows.fetch_add(1, std::memory_order_relaxed);
+		AllocatedBytes.fetch_add(static_cast<int64>(EndSize) - static_cast<int64>(StartSize), std::memory_order_relaxed);
+	}
+	
+	FScopeLock ScopeLock(&Lock);
+	Free.Emplace(MoveTemp(Scratch));
+}
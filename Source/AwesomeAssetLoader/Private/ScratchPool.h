@@ -0,0 +1,78 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/** Memory allocated by libraries, their sorts and their loads. Run with -llm to see it. */
+LLM_DECLARE_TAG(AwesomeAssetLoader);
+
+/** Working memory of one filter and sort. Only ever grows, so after the first few calls on a library it stops allocating. */
+struct FFilterAndSortScratch
+{
+	/** Filtered items as bits over the whole library */
+	TBitArray<> FilteredBits;
+
+	/** Per chunk results of parallel jobs */
+	TArray<TArray<int32>> Chunks;
+
+	/** Where each chunk starts in the joined result */
+	TArray<int32> ChunkStarts;
+
+	/** Packed composite sort keys by item, and the key and item buffers radix passes swap between */
+	TArray<uint64> PackedKeys;
+	TArray<uint64> RadixKeys[2];
+	TArray<int32> RadixItems;
+
+	/** Bytes held by the buffers */
+	SIZE_T GetAllocatedSize() const;
+};
+
+/**
+ * Hands scratch out to whoever filters and sorts, from any thread.
+ * Every user gets a scratch of its own for as long as it holds it, so tasks never share one, even when a wait runs another task on the same thread.
+ */
+class FScratchPool
+{
+public:
+
+	/** Holds a scratch from the pool until it goes out of scope */
+	class FScope
+	{
+	public:
+		FScope();
+		~FScope();
+
+		FScope(const FScope&) = delete;
+		FScope& operator=(const FScope&) = delete;
+
+		FORCEINLINE FFilterAndSortScratch& operator*() const { return *Scratch; }
+		FORCEINLINE FFilterAndSortScratch* operator->() const { return Scratch.Get(); }
+
+	private:
+		TUniquePtr<FFilterAndSortScratch> Scratch;
+		SIZE_T StartSize = 0;
+	};
+
+	static FScratchPool& Get();
+
+	/** Number of times a scratch had to grow since start up, each of which is a heap allocation. Unchanged between two calls means no scratch was allocated. */
+	FORCEINLINE int64 GetNumGrows() const { return NumGrows.load(std::memory_order_relaxed); }
+
+	/** Bytes held by every scratch, free or in use */
+	FORCEINLINE int64 GetAllocatedBytes() const { return AllocatedBytes.load(std::memory_order_relaxed); }
+
+private:
+
+	TUniquePtr<FFilterAndSortScratch> Acquire();
+	void Release(TUniquePtr<FFilterAndSortScratch>&& Scratch, const SIZE_T StartSize);
+
+	FCriticalSection Lock;
+
+	/** Scratch that nobody holds, most recently released last so it is the most likely to be big enough */
+	TArray<TUniquePtr<FFilterAndSortScratch>> Free;
+
+	std::atomic<int64> NumGrows { 0 };
+	std::atomic<int64> AllocatedBytes { 0 };
+};
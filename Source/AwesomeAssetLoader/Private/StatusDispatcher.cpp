@@ -0,0 +1,113 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StatusDispatcher.h"
+#include "ItemLibrary.h"
+#include "Algo/StableSort.h"
+
+
+FStatusDispatcher::~FStatusDispatcher()
+{
+	if (TickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	}
+}
+
+void FStatusDispatcher::Enqueue(FItemLibrary* Library, const int32 ItemIndex)
+{
+	check(IsInGameThread());
+	Queue.Emplace(FQueuedItem{ Library, ItemIndex });
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+		{
+			const bool bMore = Dispatch();
+			if (!bMore)
+			{
+				TickerHandle.Reset();
+			}
+			return bMore;
+		}));
+	}
+}
+
+void FStatusDispatcher::RemoveLibrary(const FItemLibrary* Library)
+{
+	Queue.RemoveAll([Library](const FQueuedItem& Item) { return Item.Library == Library; });
+	for (FQueuedItem& Item : Delivering)
+	{
+		if (Item.Library == Library)
+		{
+			Item.Library = nullptr;
+		}
+	}
+}
+
+bool FStatusDispatcher::Dispatch()
+{
+	// Nearest band first and unloads last. Ties keep the order they were queued in.
+	const auto GetOrder = [](const FQueuedItem& Item)
+	{
+		const uint8 Band = Item.Library->Items[Item.ItemIndex].LoadBand;
+		return Band == FBufferWindow::NoBand ? MAX_uint8 : Band;
+	};
+	Delivering = MoveTemp(Queue);
+	Algo::StableSortBy(Delivering, GetOrder);
+
+	struct FLibraryChanges
+	{
+		FName LibraryName;
+		TArray<FName> Loaded;
+		TArray<FName> Unloaded;
+	};
+	TArray<FLibraryChanges, TInlineAllocator<4>> Changes;
+	
+	const double EndTime = FPlatformTime::Seconds() + Settings.BudgetMilliseconds / 1000.f;
+	int32 NumDelivered = 0;
+	int32 Next = 0;
+	while (Next < Delivering.Num() && (NumDelivered == 0 || (NumDelivered < Settings.MaxPerFrame && FPlatformTime::Seconds() < EndTime)))
+	{
+		const FQueuedItem Queued = Delivering[Next++];
+		if (!Queued.Library)
+		{
+			continue;
+		}
+		
+		// Skip changes that went back to what was last delivered
+		FAwesomeAssetData& Item = Queued.Library->Items[Queued.ItemIndex];
+		Item.bStatusQueued = false;
+		if (Item.bQueuedStatus == Item.bDeliveredStatus)
+		{
+			continue;
+		}
+		Item.bDeliveredStatus = Item.bQueuedStatus;
+		++NumDelivered;
+
+		FLibraryChanges* LibraryChanges = Changes.FindByPredicate([&Queued](const FLibraryChanges& Entry) { return Entry.LibraryName == Queued.Library->Name; });
+		if (!LibraryChanges)
+		{
+			LibraryChanges = &Changes.Emplace_GetRef();
+			LibraryChanges->LibraryName = Queued.Library->Name;
+		}
+		(Item.bDeliveredStatus ? LibraryChanges->Loaded : LibraryChanges->Unloaded).Emplace(Item.UniqueId);
+		
+		Item.OnStatusChange.ExecuteIfBound(Item.bDeliveredStatus);
+	}
+
+	// What did not fit goes ahead of anything queued while delivering
+	Delivering.RemoveAt(0, Next);
+	Delivering.RemoveAll([](const FQueuedItem& Item) { return !Item.Library; });
+	Queue.Insert(MoveTemp(Delivering), 0);
+	Delivering.Reset();
+
+	if (OnDelivered)
+	{
+		for (const FLibraryChanges& LibraryChanges : Changes)
+		{
+			OnDelivered(LibraryChanges.LibraryName, LibraryChanges.Loaded, LibraryChanges.Unloaded);
+		}
+	}
+	
+	return !Queue.IsEmpty();
+}
@@ -0,0 +1,70 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "StatusDispatcher.generated.h"
+
+class FItemLibrary;
+
+/** How OnStatusChange is delivered to items */
+USTRUCT(BlueprintType)
+struct FStatusDispatchSettings
+{
+	GENERATED_BODY()
+
+	/** Queue status changes and deliver them on later frames. Off fires each change the moment it happens. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Status Dispatch")
+	bool bEnabled = false;
+
+	/** Most status changes delivered in one frame */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Status Dispatch", meta=(ClampMin=1))
+	int32 MaxPerFrame = 64;
+
+	/** Time a frame may spend delivering status changes. At least one is delivered per frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Status Dispatch", meta=(ClampMin=0))
+	float BudgetMilliseconds = 1.f;
+};
+
+/**
+ * Queues status changes of the items of every library and delivers them a frame budget at a time, target range first.
+ * An item only keeps its latest change, and a change back to what it last delivered is dropped. Game thread only.
+ */
+class FStatusDispatcher
+{
+public:
+
+	/** Called once per library per frame with the unique Ids of the items delivered that frame */
+	using FOnDelivered = TFunction<void(FName /*LibraryName*/, const TArray<FName>& /*Loaded*/, const TArray<FName>& /*Unloaded*/)>;
+
+	~FStatusDispatcher();
+
+	FStatusDispatchSettings Settings;
+
+	FOnDelivered OnDelivered;
+
+	/** Queues the latest status of the item. See FAwesomeAssetData::bQueuedStatus. */
+	void Enqueue(FItemLibrary* Library, const int32 ItemIndex);
+
+	/** Forgets every queued item of a library without calling back into it */
+	void RemoveLibrary(const FItemLibrary* Library);
+
+private:
+
+	struct FQueuedItem
+	{
+		FItemLibrary* Library;
+		int32 ItemIndex;
+	};
+
+	/** Delivers what fits in the frame budget. Returns true if some are left. */
+	bool Dispatch();
+
+	TArray<FQueuedItem> Queue;
+
+	/** Items being delivered this frame. Delegates can remove libraries while these are walked. */
+	TArray<FQueuedItem> Delivering;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,240 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TagMaskFilter.h"
+#include "ItemLibrary.h"
+#include "ScratchPool.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_CPU_X86_FAMILY && PLATFORM_ENABLE_VECTORINTRINSICS
+	#include <immintrin.h>
+	#define AAM_TAG_FILTER_SSE2 1
+	#define AAM_TAG_FILTER_AVX2 PLATFORM_ALWAYS_HAS_AVX_2
+#else
+	#define AAM_TAG_FILTER_SSE2 0
+	#define AAM_TAG_FILTER_AVX2 0
+#endif
+
+namespace TagMaskFilter
+{
+	/** Kernel for libraries with 64 or fewer dictionary tags, where every item's mask is a single word. */
+	void EvaluateSingleWord(const uint64* Masks, const int32 StartIndex, const int32 EndIndex, const uint64 MustHave, const uint64 MustNotHave, TArray<int32>& OutPassed)
+	{
+		int32 ItemIndex = StartIndex;
+
+#if AAM_TAG_FILTER_AVX2
+		// Four items per step
+		const __m256i MustHaveV = _mm256_set1_epi64x(static_cast<int64>(MustHave));
+		const __m256i MustNotHaveV = _mm256_set1_epi64x(static_cast<int64>(MustNotHave));
+		const __m256i Zero = _mm256_setzero_si256();
+		for (; ItemIndex + 4 <= EndIndex; ItemIndex += 4)
+		{
+			const __m256i Mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Masks + ItemIndex));
+			const __m256i Reject = _mm256_or_si256(_mm256_andnot_si256(Mask, MustHaveV), _mm256_and_si256(Mask, MustNotHaveV));
+			uint32 Passed = static_cast<uint32>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(Reject, Zero))));
+			while (Passed)
+			{
+				OutPassed.Emplace(ItemIndex + FMath::CountTrailingZeros(Passed));
+				Passed &= Passed - 1;
+			}
+		}
+#elif AAM_TAG_FILTER_SSE2
+		// Two items per step. SSE2 has no 64 bit compare so both 32 bit halves have to be zero.
+		const __m128i MustHaveV = _mm_set1_epi64x(static_cast<int64>(MustHave));
+		const __m128i MustNotHaveV = _mm_set1_epi64x(static_cast<int64>(MustNotHave));
+		const __m128i Zero = _mm_setzero_si128();
+		for (; ItemIndex + 2 <= EndIndex; ItemIndex += 2)
+		{
+			const __m128i Mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Masks + ItemIndex));
+			const __m128i Reject = _mm_or_si128(_mm_andnot_si128(Mask, MustHaveV), _mm_and_si128(Mask, MustNotHaveV));
+			const int32 Passed = _mm_movemask_epi8(_mm_cmpeq_epi32(Reject, Zero));
+			if ((Passed & 0x00FF) == 0x00FF)
+			{
+				OutPassed.Emplace(ItemIndex);
+			}
+			if ((Passed & 0xFF00) == 0xFF00)
+			{
+				OutPassed.Emplace(ItemIndex + 1);
+			}
+		}
+#endif
+
+		// Scalar fallback and tail
+		for (; ItemIndex < EndIndex; ++ItemIndex)
+		{
+			const uint64 Mask = Masks[ItemIndex];
+			if (((~Mask & MustHave) | (Mask & MustNotHave)) == 0)
+			{
+				OutPassed.Emplace(ItemIndex);
+			}
+		}
+	}
+
+	/** Kernel for libraries with more than 64 dictionary tags */
+	void EvaluateMultiWord(const uint64* Masks, const int32 StartIndex, const int32 EndIndex, const int32 MaskWords, const uint64* MustHave, const uint64* MustNotHave, TArray<int32>& OutPassed)
+	{
+		for (int32 ItemIndex = StartIndex; ItemIndex < EndIndex; ++ItemIndex)
+		{
+			const uint64* Mask = Masks + static_cast<SIZE_T>(ItemIndex) * MaskWords;
+			int32 Word = 0;
+			uint64 Reject = 0;
+
+#if AAM_TAG_FILTER_SSE2
+			__m128i RejectV = _mm_setzero_si128();
+			for (; Word + 2 <= MaskWords; Word += 2)
+			{
+				const __m128i MaskV = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Mask + Word));
+				const __m128i MustHaveV = _mm_loadu_si128(reinterpret_cast<const __m128i*>(MustHave + Word));
+				const __m128i MustNotHaveV = _mm_loadu_si128(reinterpret_cast<const __m128i*>(MustNotHave + Word));
+				RejectV = _mm_or_si128(RejectV, _mm_or_si128(_mm_andnot_si128(MaskV, MustHaveV), _mm_and_si128(MaskV, MustNotHaveV)));
+			}
+			Reject = _mm_movemask_epi8(_mm_cmpeq_epi32(RejectV, _mm_setzero_si128())) != 0xFFFF;
+#endif
+
+			for (; Word < MaskWords; ++Word)
+			{
+				Reject |= (~Mask[Word] & MustHave[Word]) | (Mask[Word] & MustNotHave[Word]);
+			}
+
+			if (Reject == 0)
+			{
+				OutPassed.Emplace(ItemIndex);
+			}
+		}
+	}
+}
+
+FTagMaskFilter FTagMaskFilter::Compile(const FItemDescriptionTable& Descriptions, const FGameplayTagContainer& MustHaveTags, const FGameplayTagContainer& MustNotHaveTags)
+{
+	FTagMaskFilter Filter;
+	Filter.MustHave.SetNumZeroed(Descriptions.MaskWords);
+	Filter.MustNotHave.SetNumZeroed(Descriptions.MaskWords);
+
+	for (const FGameplayTag& Tag : MustHaveTags)
+	{
+		const int32 Bit = Descriptions.FindBit(Tag);
+		if (Bit == INDEX_NONE)
+		{
+			// No item has this tag or a child of it
+			Filter.bCanMatch = false;
+			continue;
+		}
+		Filter.MustHave[Bit >> 6] |= 1ull << (Bit & 63);
+	}
+
+	for (const FGameplayTag& Tag : MustNotHaveTags)
+	{
+		// Tags unknown to the library can not reject anything
+		const int32 Bit = Descriptions.FindBit(Tag);
+		if (Bit != INDEX_NONE)
+		{
+			Filter.MustNotHave[Bit >> 6] |= 1ull << (Bit & 63);
+		}
+	}
+
+	return Filter;
+}
+
+void FTagMaskFilter::Evaluate(const FItemDescriptionTable& Descriptions, TArray<int32>& OutPassed, const FSortCancellation* Cancellation) const
+{
+	OutPassed.Reset(Descriptions.NumItems);
+	if (!bCanMatch)
+	{
+		return;
+	}
+
+	// Evaluated in slices so that cancellation is checked between them
+	const int32 SliceSize = Cancellation ? FSortCancellation::CheckInterval : FMath::Max(1, Descriptions.NumItems);
+	for (int32 StartIndex = 0; StartIndex < Descriptions.NumItems; StartIndex += SliceSize)
+	{
+		if (Cancellation && Cancellation->IsCancelled())
+		{
+			return;
+		}
+		EvaluateRange(Descriptions, StartIndex, FMath::Min(StartIndex + SliceSize, Descriptions.NumItems), OutPassed);
+	}
+}
+
+bool FTagMaskFilter::Passes(const FItemDescriptionTable& Descriptions, const int32 ItemIndex) const
+{
+	if (!bCanMatch || Descriptions.IsRemoved(ItemIndex))
+	{
+		return false;
+	}
+	
+	const uint64* Mask = Descriptions.GetMask(ItemIndex);
+	for (int32 Word = 0; Word < Descriptions.MaskWords; ++Word)
+	{
+		if ((~Mask[Word] & MustHave[Word]) | (Mask[Word] & MustNotHave[Word]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FTagMaskFilter::EvaluateParallel(const FItemDescriptionTable& Descriptions, const int32 ChunkSize, FFilterAndSortScratch& Scratch, TArray<int32>& OutPassed, const FSortCancellation* Cancellation) const
+{
+	OutPassed.Reset();
+	if (!bCanMatch)
+	{
+		return;
+	}
+
+	// Chunk arrays are never shrunk so they keep their capacity for the next call
+	const int32 NumChunks = FMath::DivideAndRoundUp(Descriptions.NumItems, ChunkSize);
+	TArray<TArray<int32>>& ChunkPassed = Scratch.Chunks;
+	if (ChunkPassed.Num() < NumChunks)
+	{
+		ChunkPassed.SetNum(NumChunks);
+	}
+	ParallelFor(NumChunks, [this, &Descriptions, ChunkSize, &ChunkPassed, Cancellation](const int32 Chunk)
+	{
+		const int32 StartIndex = Chunk * ChunkSize;
+		const int32 EndIndex = FMath::Min(StartIndex + ChunkSize, Descriptions.NumItems);
+		ChunkPassed[Chunk].Reset(EndIndex - StartIndex);
+		if (!Cancellation || !Cancellation->IsCancelled())
+		{
+			EvaluateRange(Descriptions, StartIndex, EndIndex, ChunkPassed[Chunk]);
+		}
+	});
+
+	// Chunks are in item order so concatenating keeps the result ascending
+	int32 NumPassed = 0;
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		NumPassed += ChunkPassed[Chunk].Num();
+	}
+	OutPassed.Reserve(NumPassed);
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		OutPassed.Append(ChunkPassed[Chunk]);
+	}
+}
+
+void FTagMaskFilter::EvaluateRange(const FItemDescriptionTable& Descriptions, const int32 StartIndex, const int32 EndIndex, TArray<int32>& OutPassed) const
+{
+	check(MustHave.Num() == Descriptions.MaskWords && MustNotHave.Num() == Descriptions.MaskWords);
+	const int32 FirstPassed = OutPassed.Num();
+	if (Descriptions.MaskWords == 1)
+	{
+		TagMaskFilter::EvaluateSingleWord(Descriptions.TagMasks.GetData(), StartIndex, EndIndex, MustHave[0], MustNotHave[0], OutPassed);
+	}
+	else
+	{
+		TagMaskFilter::EvaluateMultiWord(Descriptions.TagMasks.GetData(), StartIndex, EndIndex, Descriptions.MaskWords, MustHave.GetData(), MustNotHave.GetData(), OutPassed);
+	}
+
+	// Removed items have no tags so they only get through filters without must have tags
+	if (Descriptions.NumRemoved > 0)
+	{
+		int32 NumKept = FirstPassed;
+		for (int32 Passed = FirstPassed; Passed < OutPassed.Num(); ++Passed)
+		{
+			if (!Descriptions.IsRemoved(OutPassed[Passed]))
+			{
+				OutPassed[NumKept++] = OutPassed[Passed];
+			}
+		}
+		OutPassed.SetNum(NumKept, EAllowShrinking::No);
+	}
+}
@@ -0,0 +1,53 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+
+struct FItemDescriptionTable;
+struct FFilterAndSortScratch;
+struct FSortCancellation;
+
+/**
+ * MustHaveTags and MustNotHaveTags compiled into bitmasks over a library's tag dictionary.
+ * Since the dictionary holds the parents of every description tag, a whole filter is a single AND and compare per item.
+ */
+struct FTagMaskFilter
+{
+	/** Bits that an item must all have */
+	TArray<uint64> MustHave;
+
+	/** Bits that an item must not have any of */
+	TArray<uint64> MustNotHave;
+
+	/** False if a must have tag is not known to the library, in which case nothing can pass */
+	bool bCanMatch = true;
+
+	/** Compiles the tags against the dictionary of the given table */
+	static FTagMaskFilter Compile(const FItemDescriptionTable& Descriptions, const FGameplayTagContainer& MustHaveTags, const FGameplayTagContainer& MustNotHaveTags);
+
+	/** Replaces OutPassed with the index of every item that passes, in ascending order. Stops part way if cancelled. */
+	void Evaluate(const FItemDescriptionTable& Descriptions, TArray<int32>& OutPassed, const FSortCancellation* Cancellation = nullptr) const;
+
+	/** Does a single item pass */
+	bool Passes(const FItemDescriptionTable& Descriptions, const int32 ItemIndex) const;
+
+	/** Same as Evaluate but splits the items into chunks of ChunkSize that are evaluated across worker threads. Chunk results are kept in Scratch. */
+	void EvaluateParallel(const FItemDescriptionTable& Descriptions, const int32 ChunkSize, FFilterAndSortScratch& Scratch, TArray<int32>& OutPassed, const FSortCancellation* Cancellation = nullptr) const;
+
+	bool operator==(const FTagMaskFilter& Other) const
+	{
+		return bCanMatch == Other.bCanMatch && MustHave == Other.MustHave && MustNotHave == Other.MustNotHave;
+	}
+
+	bool operator!=(const FTagMaskFilter& Other) const
+	{
+		return !(*this == Other);
+	}
+
+private:
+
+	/** Appends the passing items of [StartIndex, EndIndex) to OutPassed */
+	void EvaluateRange(const FItemDescriptionTable& Descriptions, const int32 StartIndex, const int32 EndIndex, TArray<int32>& OutPassed) const;
+};
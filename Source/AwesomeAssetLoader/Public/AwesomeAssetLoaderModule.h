@@ -12,4 +12,9 @@ public:
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+private:
+#if WITH_EDITOR
+	FDelegateHandle CookStartedHandle;
+#endif
 };
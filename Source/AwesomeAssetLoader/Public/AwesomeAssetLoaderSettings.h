@@ -0,0 +1,49 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "UObject/SoftObjectPtr.h"
+#include "Engine/DataTable.h"
+#include "AwesomeAssetLoaderSettings.generated.h"
+
+/** A data table of FAwesomeAssetRow rows that is built into a library file ahead of time */
+USTRUCT(BlueprintType)
+struct FCookedItemLibrary
+{
+	GENERATED_BODY()
+
+	/** The name that the library is added under and its file is named after */
+	UPROPERTY(EditAnywhere, Category="AwesomeAssetLoader")
+	FName LibraryName;
+
+	UPROPERTY(EditAnywhere, Category="AwesomeAssetLoader")
+	TSoftObjectPtr<UDataTable> DataTable;
+};
+
+/**
+ * Libraries that are built when cooking, or by running the BuildItemLibraries commandlet, so the game only maps them in.
+ * Add the output directory to DirectoriesToAlwaysStageAsNonUFS so the files are staged loose where they can be mapped.
+ */
+UCLASS(Config=Game, DefaultConfig, meta=(DisplayName="Awesome Asset Loader"))
+class AWESOMEASSETLOADER_API UAwesomeAssetLoaderSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	UAwesomeAssetLoaderSettings()
+	{
+		CategoryName = TEXT("Plugins");
+	}
+
+	UPROPERTY(Config, EditAnywhere, Category="AwesomeAssetLoader")
+	TArray<FCookedItemLibrary> CookedLibraries;
+
+	/** Where library files are written, relative to the project's content directory */
+	UPROPERTY(Config, EditAnywhere, Category="AwesomeAssetLoader")
+	FString OutputDirectory = TEXT("ItemLibraries");
+
+	/** The file a cooked library is written to and added from */
+	FString GetLibraryFilePath(FName LibraryName) const;
+};
@@ -8,38 +8,24 @@
 #include "ItemLibrary.h"
 #include "GameplayTagContainer.h"
 #include "UObject/PrimaryAssetId.h"
+#include "AssetRegistry/ARFilter.h"
 #include "AwesomeAssetManager.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(FLogAwesomeAssetManager, Log, All);
 DECLARE_DYNAMIC_DELEGATE_OneParam(FK2_OnStatusChange, bool, bShouldLoad);
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnAssetLibraryBuilt, FName, LibraryName);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnStatusChangesDelivered, FName, LibraryName, const TArray<FName>&, Loaded, const TArray<FName>&, Unloaded);
+
+struct FFilterAndSortScratch;
 
 
 /**
  * ~~~~ TODOs ~~~~
  * Handle so that libraries do not persist between level changes.
  * Add profiling
- * Add a way to supply an ordered list and keep it ordered.
  * Should asset data take in an arbitrary set of pointers to give back when asked for the sorted items? if this more useful than the unique Ids?
  */
 
-USTRUCT(Blueprintable, BlueprintType)
-struct FFilterAndSortCriterion
-{
-	GENERATED_BODY()
-
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
-	FGameplayTagContainer MustHaveTags;
-
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
-	FGameplayTagContainer MustNotHaveTags;
-
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
-	TArray<FGameplayTag> SortOrder;
-
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category=Criteria)
-	bool bSortValuesDescending = false;
-};
-
 /**
  * 
  */
@@ -49,10 +35,13 @@ class AWESOMEASSETLOADER_API UAwesomeAssetManager : public UGameInstanceSubsyste
 	GENERATED_BODY()
 	
 public:
+
+	/** Shuts every library down before the manager goes */
+	virtual void Deinitialize() override;
 	
 	/**
 	 * Add a new library of assets to manage.
-	 * If a library with the same name already exists it will be replaced.
+	 * If a library with the same name already exists it will be replaced. A name taken by a view of another library can not be used.
 	 * @param LibraryName		The name that the library should be referenced by.
 	 * @param Assets			Assets to be tracked by the newly created library.
 	 * @return					Was successful.
@@ -65,7 +54,101 @@ public:
 	 * @param LibraryName		The library that should be dumped.
 	 */
 	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
-	void RemoveAssetLibrary(FName LibraryName) { Libraries.Remove(LibraryName); }
+	void RemoveAssetLibrary(FName LibraryName);
+
+	/**
+	 * Build a new library from the builder's items on a worker thread.
+	 * The library can be found by name once OnComplete is called. It replaces any library with the same name at that point.
+	 * It is dropped without calling OnComplete if a view of another library has the name by then.
+	 * @param LibraryName		The name that the library should be referenced by.
+	 * @param Builder			Items of the library, in the order they should be indexed.
+	 * @param OnComplete		Called on the game thread once the library is added.
+	 * @return					Was successful.
+	 */
+	bool BuildAssetLibrary(FName LibraryName, FItemLibraryBuilder&& Builder, FSimpleDelegate OnComplete);
+
+	/**
+	 * Build a new library from the rows of a data table on a worker thread. Each row name becomes an item's unique Id.
+	 * Items built this way have no OnStatusChange of their own. Use OnStatusChangesDelivered with the status dispatcher.
+	 * @param LibraryName		The name that the library should be referenced by.
+	 * @param DataTable			A table of FAwesomeAssetRow rows.
+	 * @param OnComplete		Called once the library is added.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddAssetLibraryFromDataTable(FName LibraryName, const UDataTable* DataTable, FOnAssetLibraryBuilt OnComplete);
+
+	/**
+	 * Build a new library from the assets an asset registry query finds on a worker thread. Each asset's object path becomes its unique Id.
+	 * Items built this way have no OnStatusChange of their own. Use OnStatusChangesDelivered with the status dispatcher.
+	 * @param LibraryName		The name that the library should be referenced by.
+	 * @param Filter			Which assets to add. Each asset is an item that loads itself.
+	 * @param DescriptionTags	Asset registry tags to describe the items with. A number value is used for sorting, otherwise 0.
+	 * @param OnComplete		Called once the library is added.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddAssetLibraryFromAssetRegistry(FName LibraryName, const FARFilter& Filter, const TMap<FName, FGameplayTag>& DescriptionTags, FOnAssetLibraryBuilt OnComplete);
+
+	/**
+	 * Add a library from a file written by SaveAssetLibrary. The file is memory mapped and the library's tables read it in place without being rebuilt.
+	 * It stays mapped while the library uses it. Only the parts that items are added to or updated in are copied out.
+	 * Items added this way have no OnStatusChange of their own. Use OnStatusChangesDelivered with the status dispatcher.
+	 * @param LibraryName		The name that the library should be referenced by.
+	 * @param FilePath			The library file.
+	 * @return					Was successful. Fails for files from another version or that use tags that no longer exist.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddAssetLibraryFromFile(FName LibraryName, const FString& FilePath);
+
+	/**
+	 * Add a library that was built when cooking or by the BuildItemLibraries commandlet. See UAwesomeAssetLoaderSettings.
+	 * @param LibraryName		The library's name in the settings, which it is also referenced by.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddCookedAssetLibrary(FName LibraryName);
+
+	/**
+	 * Write a library to a file that AddAssetLibraryFromFile can load.
+	 * Libraries built from data tables are better listed in UAwesomeAssetLoaderSettings so they are written when cooking.
+	 * Files are in the byte order of the platform that wrote them.
+	 * @param LibraryName		The library to save.
+	 * @param FilePath			Where to write it.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SaveAssetLibrary(FName LibraryName, const FString& FilePath);
+
+	/**
+	 * Append items to an existing library. Their descriptions are merged into the latest filtered and sorted result without sorting it again.
+	 * Items with tags the library has not seen yet make it rebuild its descriptions and filter and sort again.
+	 * A filter and sort that is still running when items change is started again on the changed items, and calls its OnComplete once that finishes.
+	 * @param LibraryName		The library to add to.
+	 * @param Assets			Items to add, after those already in the library.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddItemsToLibrary(FName LibraryName, TArray<FAssetInitializeData> Assets);
+
+	/**
+	 * Remove items from a library by their unique Id. They are taken out of the sorted order and their loads are released.
+	 * @param LibraryName		The library to remove from.
+	 * @param UniqueIds			Items to remove. Ids that are not found are skipped.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool RemoveItemsFromLibrary(FName LibraryName, const TArray<FName>& UniqueIds);
+
+	/**
+	 * Replace the description of an item, moving it to its new place in the latest filtered and sorted result.
+	 * @param LibraryName		The library the item belongs to.
+	 * @param UniqueId			The unique Id of the item.
+	 * @param AssetDescriptions	The new description values.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool UpdateItemDescription(FName LibraryName, FName UniqueId, const TMap<FGameplayTag, float>& AssetDescriptions);
 
 	/**
 	 * 
@@ -80,13 +163,42 @@ public:
 	void K2_FilterAndSortAssets(FName LibraryName, const FFilterAndSortCriterion& Criterion, FOnFilteredAndSorted OnComplete, bool bAllowAsynchronous = false);
 
 	/**
-	 * Return the filtered and sorted assets by their unique Id
+	 * Return the filtered and sorted assets by their unique Id.
+	 * This is the latest finished result. An asynchronous filter and sort that is still running is not waited on.
+	 * If only the start of a lazy sort's order is laid out yet, the rest is laid out on the calling thread.
 	 * @return Success
 	 */
 	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
 	bool GetSortedAssets(FName LibraryName, TArray<FName>& SortedAssets);
 
-	bool SetBufferTarget(TSharedPtr<FItemLibrary> Library, int32 TargetStart, int32 TargetEnd, const int32 BufferSize);
+	/**
+	 * Return one range of the filtered and sorted assets by their unique Id, for showing a page of them.
+	 * @param LibraryName		The library to read.
+	 * @param Start				Sorted position of the first asset to return.
+	 * @param Count				Number of assets to return. Fewer are returned past the end of the order.
+	 * @param SortedAssets		Emptied, keeping its memory, and filled with the range.
+	 * @param NumSorted			Number of assets in the full order.
+	 * @param Generation		Changes whenever the order does. A caller can skip reading while it is the same as last time.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool GetSortedAssetRange(FName LibraryName, int32 Start, int32 Count, TArray<FName>& SortedAssets, int32& NumSorted, int32& Generation);
+
+	/**
+	 * Same as GetSortedAssetRange but reads the range in place, without copying or allocating.
+	 * The view keeps reading the result it was made from until it is made again.
+	 */
+	bool GetSortedAssetView(FName LibraryName, int32 Start, int32 Count, FSortedAssetView& OutView);
+
+	/**
+	 * Find which filtered and sorted result a library has, to tell whether its order changed since it was last read.
+	 * @param LibraryName		The library to look at.
+	 * @return					Generation of the latest result, or INDEX_NONE if the library is not found.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	int32 GetSortedAssetsGeneration(FName LibraryName);
+
+	bool SetBufferTarget(TSharedPtr<FLibraryView> View, int32 TargetStart, int32 TargetEnd, const int32 BufferSize);
 
 	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
 	bool SetBufferTargetByIndex(FName LibraryName, const int32 AssetIndex, int32 CoreExtent, const int32 BufferSize);
@@ -94,24 +206,218 @@ public:
 	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
 	bool SetBufferTargetByUniqueId(FName LibraryName, FName UniqueId, int32 CoreExtent, const int32 BufferSize);
 
+	/**
+	 * Find where an asset is in the latest sorted order.
+	 * @param LibraryName		The library the asset belongs to.
+	 * @param UniqueId			The unique Id of the asset.
+	 * @return					Index into the sorted assets, or INDEX_NONE if the asset is not found or is filtered out.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	int32 GetSortedIndexByUniqueId(FName LibraryName, FName UniqueId);
+
 	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
 	bool SetBufferTargetByPage(FName LibraryName, const int32 PageIndex, const int32 PageSize, const int32 NumBufferPages);
+
+	/**
+	 * Add a view to a library, with its own filter and sort and its own buffer target. Views share the library's items,
+	 * so an item that is in the buffer of several views is loaded once, at the priority of the nearest.
+	 * Every function that takes a library name also takes a view name, acting on the view, or on its library for what views share.
+	 * A library's own name stands for its default view.
+	 * @param LibraryName		The library, or one of its views, to add the view to.
+	 * @param ViewName			Name of the new view. Can not be the name of another library or view.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool AddLibraryView(FName LibraryName, FName ViewName);
+
+	/**
+	 * Remove a view added with AddLibraryView. What only its buffer needed is unloaded.
+	 * @param ViewName			The view to remove.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool RemoveLibraryView(FName ViewName);
+
+	/**
+	 * Choose when a library filters and sorts across several worker threads.
+	 * @param LibraryName		The library to change.
+	 * @param Mode				Automatic only goes parallel for large libraries.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SetParallelFilterAndSort(FName LibraryName, EParallelFilterAndSort Mode);
+
+	/**
+	 * Make asynchronous filter and sort requests of a library publish the part of the order the buffer needs first and call OnComplete then.
+	 * The rest is sorted on the same task. Moving the buffer further before it finishes lays out more of the order on the game thread.
+	 * Criteria with sort keys are always published fully sorted.
+	 * @param LibraryName		The library to change.
+	 * @param bEnabled			Off publishes only the fully sorted result.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SetLazySort(FName LibraryName, bool bEnabled);
+
+	/**
+	 * Count the assets of the latest filtered and sorted result.
+	 * @param LibraryName		The library to look at.
+	 * @param NumSorted			Assets in the full order.
+	 * @param bFullyOrdered		False while a lazy sort has only laid out the start of the order.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool GetNumSortedAssets(FName LibraryName, int32& NumSorted, bool& bFullyOrdered);
+
+	/**
+	 * Make asynchronous filter and sort requests of a library wait for later ones, so a burst of them, like typing in a search box, is done once.
+	 * Each request still stops the one running before it. Synchronous requests are never delayed.
+	 * @param LibraryName			The library to change.
+	 * @param DebounceMilliseconds	How long after the first request of a burst to start with the latest criterion. 0 starts each right away.
+	 * @return						Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SetFilterAndSortDebounce(FName LibraryName, float DebounceMilliseconds);
+
+	/**
+	 * Count the filter and sort work a library skipped because newer requests came in.
+	 * @param LibraryName			The library to look at.
+	 * @param NumCancelledTasks		Tasks stopped before or while running.
+	 * @param NumCoalescedRequests	Requests replaced by a later one before starting.
+	 * @return						Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool GetFilterAndSortStats(FName LibraryName, int32& NumCancelledTasks, int32& NumCoalescedRequests);
+
+	/**
+	 * Skew a library's buffer toward the direction the target is moving and grade its load priorities by distance.
+	 * @param LibraryName		The library to change.
+	 * @param Settings			Takes effect on the next buffer update. The tracked speed restarts from rest.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SetPredictivePrefetch(FName LibraryName, const FPredictivePrefetchSettings& Settings);
+
+	/**
+	 * Loaded items that leave a buffer stay resident until this many bytes of them are kept across all libraries.
+	 * The least recently used are released first. Coming back into a buffer revives them without a new load.
+	 * @param BudgetBytes		Estimated from the resource size of the loaded objects. 0 releases items as soon as they leave.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	void SetResidencyBudget(int64 BudgetBytes);
+
+	/**
+	 * Limit how long a library spends issuing load requests each frame. What does not fit is issued on the next frames.
+	 * @param LibraryName		The library to change.
+	 * @param BudgetMilliseconds	Time per frame. At least one batch of requests is always issued.
+	 * @return					Was successful.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	bool SetLoadIssueBudget(FName LibraryName, float BudgetMilliseconds);
+
+	/** Estimated bytes kept by loaded items that are outside of every buffer */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="AwesomeAssetLoader")
+	int64 GetResidentBytes() const;
+
+	/**
+	 * Count the unique soft paths held by every library. A path shared by several items or libraries counts once.
+	 * @param NumPaths			Paths held by buffered or parked items.
+	 * @param NumLoadedPaths	Those of them that have finished loading.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="AwesomeAssetLoader")
+	void GetPathStats(int32& NumPaths, int32& NumLoadedPaths) const;
+
+	/**
+	 * Count the heap allocations of the scratch memory that filtering and sorting reuses between calls.
+	 * Compare the counts from before and after some filtering and sorting to see whether it allocated any. Run with -llm for every allocation.
+	 * @param NumScratchGrows	Times since start up that a scratch buffer had to grow.
+	 * @param ScratchBytes		Bytes kept for reuse.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="AwesomeAssetLoader")
+	void GetScratchStats(int64& NumScratchGrows, int64& ScratchBytes) const;
+
+	/**
+	 * Choose whether status changes are queued and delivered over several frames, target range first.
+	 * Queued changes are coalesced per item, so an item that loads and unloads before its turn is not called at all.
+	 * @param Settings			Applies to every library.
+	 */
+	UFUNCTION(BlueprintCallable, Category="AwesomeAssetLoader")
+	void SetStatusDispatch(const FStatusDispatchSettings& Settings);
+
+	/** Called each frame the status dispatcher delivers, once per library, with the unique Ids of the items it delivered */
+	UPROPERTY(BlueprintAssignable, Category="AwesomeAssetLoader")
+	FOnStatusChangesDelivered OnStatusChangesDelivered;
 	
 private:
 
-	static void FilterAndSortAssetsInternal(const TSet<TSharedPtr<FAwesomeAssetData>>& Items, const ::FGameplayTagContainer& MushHaveTagsCache, const ::
-	                                        FGameplayTagContainer& MushNotHaveTagsCache, const FFilterAndSortCriterion& Criterion, TSet<TSharedPtr<FAwesomeAssetData>>& FilteredAssets, TArray<TSharedPtr<FAwesomeAssetData>>& SortedAssets);
+	/** Builds Result from the criterion, reusing whatever parts of Previous still apply */
+	static bool FilterAndSortAssetsInternal(const FItemDescriptionTable& Descriptions, FQueryPlanCache& QueryPlans, const FSortResult& Previous, const FFilterAndSortCriterion& Criterion, const bool bParallel, const FSortCancellation& Cancellation, FSortResult& Result);
+
+	/** Filters Result by the criterion, carrying over the sorted columns of Previous if the filtered items are the same */
+	static bool FilterAssetsInternal(const FItemDescriptionTable& Descriptions, FQueryPlanCache& QueryPlans, const FSortResult& Previous, const FFilterAndSortCriterion& Criterion, const bool bParallel, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, FSortResult& Result);
+
+	/** Sorts the filtered items of Result by its criterion, gathering the sorted columns it does not have yet */
+	static bool SortAssetsInternal(const FItemDescriptionTable& Descriptions, const bool bParallel, FFilterAndSortScratch& Scratch, const FSortCancellation& Cancellation, FSortResult& Result);
+
+	/** Filters and sorts on a task, publishing the result unless a newer request supersedes it first */
+	static void LaunchFilterAndSort(const TSharedRef<FLibraryView>& View, const FFilterAndSortCriterion& Criterion, FSimpleDelegate OnComplete);
+
+	/** Maps the tags of a sort order to the columns of the table */
+	static void ResolveSortColumns(const FItemDescriptionTable& Descriptions, const TArray<FGameplayTag>& SortOrder, TArray<int32>& SortColumns);
+
+	/** Lays out SortedAssets and SortedPositions from the filtered items and their cached sorted columns */
+	static void ComposeSortedAssets(const FItemDescriptionTable& Descriptions, const TArray<int32>& SortColumns, const bool bDescending, FSortResult& Result);
+
+	/** Sets the count and positions of a result whose SortedAssets is fully laid out */
+	static void FinishSortedAssets(const FItemDescriptionTable& Descriptions, FSortResult& Result);
+
+	/** Gathers the filtered items of a pre-sorted column, split into chunks across worker threads */
+	static void GatherSortedColumnParallel(const TConstArrayView<FColumnEntry> Entries, const TBitArray<>& FilteredBits, FFilterAndSortScratch& Scratch, TArray<int32>& SortedColumn);
 	
-	/** Get the library by name */
+	/** Get the library by name, or the library of the view with the name */
 	FORCEINLINE TSharedPtr<FItemLibrary> GetLibrary(const FName& LibraryName)
 	{
-		TSharedPtr<FItemLibrary>* LibraryPointer = Libraries.Find(LibraryName);
-		return LibraryPointer ? *LibraryPointer : nullptr;
+		const TSharedPtr<FLibraryView> View = GetView(LibraryName);
+		return View ? TSharedPtr<FItemLibrary>(View->Library->AsShared()) : nullptr;
+	}
+
+	/** Get the view by name. A library's name finds its default view. */
+	FORCEINLINE TSharedPtr<FLibraryView> GetView(const FName& ViewName)
+	{
+		TSharedPtr<FLibraryView>* ViewPointer = Views.Find(ViewName);
+		check(!ViewPointer || (*ViewPointer)->Library);
+		return ViewPointer ? *ViewPointer : nullptr;
 	}
 
-	/** Called internally to update the buffer of the library. */
-	void UpdateBuffer(TSharedPtr<FItemLibrary> Library);
+	/** Builds a library on the calling worker thread, then adds it on the game thread */
+	static void BuildLibraryInternal(const TWeakObjectPtr<UAwesomeAssetManager>& WeakThis, FName LibraryName, TArray<FAssetInitializeData>&& Assets, FSimpleDelegate OnComplete);
+
+	/** Applies the changes to the library's items and patches the latest result of each view, or rebuilds them if the changes bring new tags */
+	void ApplyLibraryChanges(FItemLibrary& Library, FItemLibraryChanges&& Changes);
+
+	/** Builds NewResult from Previous and the table with the changed items, taking the changed items out and putting back those that pass */
+	static void PatchSortResult(const FItemDescriptionTable& NewDescriptions, const FSortResult& Previous, const TArray<int32>& ChangedItems, const TBitArray<>& ChangedBits, const bool bParallel, FSortResult& NewResult);
+
+	/** Connects a new library to what the manager shares between libraries and adds it. Fails if its name is taken by a view of another library. */
+	bool AddLibrary(const TSharedRef<FItemLibrary>& NewLibrary);
+
+	/** Disconnects a library that is removed or replaced and its views, here on the game thread rather than wherever its last reference goes */
+	void ShutdownLibrary(FItemLibrary& Library);
+
+	/** Called internally to update the buffer of the view. */
+	void UpdateBuffer(TSharedPtr<FLibraryView> View);
 	
 	/** Stores the libraries of assets by name to find easier later */
 	TMap<FName, TSharedPtr<FItemLibrary>> Libraries;
+
+	/** Every view by name, including each library's default view under the library's name */
+	TMap<FName, TSharedPtr<FLibraryView>> Views;
+
+	/** Loaded items parked after leaving a buffer, shared by every library */
+	TSharedRef<FResidencyCache> ResidencyCache = MakeShared<FResidencyCache>();
+
+	/** Reference counts of the soft paths held by every library, so each is only loaded once */
+	TSharedRef<FPathRegistry> PathRegistry = MakeShared<FPathRegistry>();
+
+	/** Queues status changes of every library when enabled */
+	TSharedRef<FStatusDispatcher> StatusDispatcher = MakeShared<FStatusDispatcher>();
 };
\ No newline at end of file